@@ -0,0 +1,149 @@
+// Compares the batch geometry kernels with the per-point glm loops they replace.
+// Build with -DPAPHOS_BENCHMARKS=ON (and -DPAPHOS_AVX2=ON for the AVX2 lanes), run paphos_geometry_bench.
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "geometry.h"
+
+constexpr size_t POINTS = 1 << 16;
+constexpr int REPEATS = 200;
+
+// Keeps results alive so the compiler can't drop the loops
+volatile float sink;
+
+// Best of REPEATS runs, in nanoseconds per point
+template<typename Fn>
+double measure(Fn fn)
+{
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    return best / POINTS;
+}
+
+void report(const char* name, double scalar, double batch, float maxError)
+{
+    printf("%-18s glm %6.2f ns/pt   batch %6.2f ns/pt   %5.2fx   max rel error %g\n", name, scalar, batch, scalar / batch, maxError);
+}
+
+// Largest per-point error relative to that point's distance from origin, so drift on the inner
+// turns isn't hidden behind the magnitude of the outer ones
+float maxRelativeError(const std::vector<glm::vec2>& expected, const PointBuffer& points, size_t count, glm::vec2 origin)
+{
+    float error = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        float magnitude = std::max(glm::distance(expected[i], origin), 1e-6f);
+        error = std::max(error, glm::distance(expected[i], glm::vec2(points.x[i], points.y[i])) / magnitude);
+    }
+    return error;
+}
+
+int main()
+{
+    // The loop spiral from editor.h, at a larger point count
+    const float a = 1.0f;
+    const float k = 0.2f;
+    const float phiStart = 1.0f;
+    const float phiStep = 0.0005f;
+    const glm::vec2 center(400.0f, 300.0f);
+
+    std::vector<glm::vec2> scalarPoints(POINTS);
+    PointBuffer points;
+    points.resize(POINTS);
+
+    double scalar = measure([&] {
+        for (size_t i = 0; i < POINTS; i++)
+        {
+            float phi = phiStart + i * phiStep;
+            scalarPoints[i] = center + a * std::exp(k * phi) * glm::vec2(std::cos(phi), std::sin(phi));
+        }
+        sink = scalarPoints[POINTS - 1].x;
+    });
+    double batch = measure([&] {
+        evaluateLogSpiral(a, k, phiStart, phiStep, POINTS, center, points.x.data(), points.y.data());
+        sink = points.x[POINTS - 1];
+    });
+    report("evaluateLogSpiral", scalar, batch, maxRelativeError(scalarPoints, points, POINTS, center));
+
+    const glm::mat3 m = rotationAbout(0.3f, center);
+    std::vector<glm::vec2> transformed(POINTS);
+    PointBuffer out;
+    out.resize(POINTS);
+    scalar = measure([&] {
+        for (size_t i = 0; i < POINTS; i++)
+        {
+            glm::vec3 p = m * glm::vec3(scalarPoints[i], 1.0f);
+            transformed[i] = glm::vec2(p);
+        }
+        sink = transformed[POINTS - 1].x;
+    });
+    batch = measure([&] {
+        transformPoints(m, points.x.data(), points.y.data(), out.x.data(), out.y.data(), POINTS);
+        sink = out.x[POINTS - 1];
+    });
+    report("transformPoints", scalar, batch, maxRelativeError(transformed, out, POINTS, center));
+
+    float scalarLength = 0.0f;
+    float batchLength = 0.0f;
+    scalar = measure([&] {
+        float length = 0.0f;
+        for (size_t i = 0; i + 1 < POINTS; i++)
+        {
+            length += glm::distance(scalarPoints[i], scalarPoints[i + 1]);
+        }
+        scalarLength = length;
+        sink = length;
+    });
+    batch = measure([&] {
+        batchLength = polylineLength(points.x.data(), points.y.data(), POINTS);
+        sink = batchLength;
+    });
+    report("polylineLength", scalar, batch, std::abs(scalarLength - batchLength) / scalarLength);
+
+    // Roughly one output point per input point, like resampling the spiral for even marker spacing
+    const float spacing = scalarLength / POINTS;
+    std::vector<glm::vec2> resampled(POINTS);
+    PointBuffer sampled;
+    sampled.resize(POINTS);
+    size_t scalarCount = 0;
+    size_t batchCount = 0;
+    scalar = measure([&] {
+        size_t written = 0;
+        float target = 0.0f;
+        float travelled = 0.0f;
+        for (size_t i = 0; i + 1 < POINTS && written < POINTS; i++)
+        {
+            float length = glm::distance(scalarPoints[i], scalarPoints[i + 1]);
+            while (target <= travelled + length && written < POINTS)
+            {
+                float t = length > 0.0f ? (target - travelled) / length : 0.0f;
+                resampled[written++] = glm::mix(scalarPoints[i], scalarPoints[i + 1], t);
+                target += spacing;
+            }
+            travelled += length;
+        }
+        scalarCount = written;
+        sink = resampled[written - 1].x;
+    });
+    batch = measure([&] {
+        batchCount = samplePolyline(points.x.data(), points.y.data(), POINTS, spacing, sampled.x.data(), sampled.y.data(), POINTS);
+        sink = sampled.x[batchCount - 1];
+    });
+    // Running arc length is summed in a different order, so the two may disagree on the last sample
+    size_t common = std::min(scalarCount, batchCount);
+    report("samplePolyline", scalar, batch, maxRelativeError(resampled, sampled, common, center));
+    return EXIT_SUCCESS;
+}
@@ -56,8 +56,9 @@ def render_skia(game, surface):
             spiral_y = HEIGHT/2 + a * math.pow(math.e, k * phi) * math.sin(phi)
             spiral_points.append(skia.Point(spiral_x, spiral_y))
 
-        # evaluate which point in spiral is closest to the loop radius
-        
+        # r = a * e^(k * phi) inverts to phi = ln(r / a) / k, so the point closest to the loop radius is found directly
+        indicator_index = min(max(round((math.log(rad / a) / k - 1) / 0.1), 0), len(spiral_points) - 1)
+
         rot_spiral_points = mat.mapPoints(spiral_points)
 
         paint.setColor(int("22666666", 16))
@@ -66,8 +67,8 @@ def render_skia(game, surface):
         canvas.drawPath(path, paint)
         
         paint.setStyle(skia.Paint.kFill_Style)
-        canvas.drawCircle(rot_spiral_points[230], 8, paint)
-        game.indicator_pos = rot_spiral_points[230]
+        canvas.drawCircle(rot_spiral_points[indicator_index], 8, paint)
+        game.indicator_pos = rot_spiral_points[indicator_index]
         # ind = int(game.loop_progress * 10.0) % 500
         for pos in game.mouse_event_locations:
             # canvas.drawCircle(pos, 14, paint)
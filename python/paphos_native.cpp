@@ -0,0 +1,382 @@
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "editor.h"
+#include "geometry.h"
+#include "core/SkPath.h"
+
+namespace py = pybind11;
+
+// Float arrays the bindings accept without converting, anything else is cast once in bulk
+using FloatArray = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+// Python passes Skia style 0xAARRGGBB, line vertices store R8G8B8A8 unorm
+uint32_t lineColor(uint32_t argb)
+{
+    return ((argb >> 16) & 0xFF) | (argb & 0xFF00) | ((argb & 0xFF) << 16) | (argb & 0xFF000000);
+}
+
+// Interleaved copy for Skia calls, which take SkPoint arrays. Nx2 arrays skip this entirely.
+const SkPoint* skiaPoints(const PointBuffer& points)
+{
+    thread_local std::vector<SkPoint> scratch;
+    scratch.resize(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        scratch[i] = {points.x[i], points.y[i]};
+    }
+    return scratch.data();
+}
+
+const SkPoint* skiaPoints(const FloatArray& points, size_t& count)
+{
+    if (points.ndim() != 2 || points.shape(1) != 2)
+    {
+        throw py::value_error("expected an array of shape (n, 2)");
+    }
+    count = static_cast<size_t>(points.shape(0));
+    return reinterpret_cast<const SkPoint*>(points.data());
+}
+
+// Live NumPy views of each PointBuffer. A size change may move the lanes and leave views reading
+// freed memory, so it is refused while any exist. Only touched with the GIL held.
+std::unordered_map<const PointBuffer*, size_t> pointViews;
+
+void checkResizable(const PointBuffer& points, size_t count)
+{
+    if (count != points.size() && pointViews.count(&points))
+    {
+        throw py::buffer_error("a PointBuffer can't change size while views of its x or y exist");
+    }
+}
+
+// View of one PointBuffer lane. Its base capsule keeps the buffer alive and counts the view
+// out once NumPy drops the last array sharing it.
+py::array_t<float> laneView(py::object owner, std::vector<float>& lane)
+{
+    using ViewBase = std::pair<py::object, const PointBuffer*>;
+    const PointBuffer* points = &owner.cast<const PointBuffer&>();
+    pointViews[points]++;
+    py::capsule base(new ViewBase(owner, points), [](void* p) {
+        auto view = static_cast<ViewBase*>(p);
+        if (--pointViews[view->second] == 0)
+        {
+            pointViews.erase(view->second);
+        }
+        delete view;
+    });
+    return py::array_t<float>({lane.size()}, {sizeof(float)}, lane.data(), base);
+}
+
+// Valid only inside an on_draw callback, Skia's canvas belongs to the frame being recorded
+struct Canvas
+{
+    SkCanvas* canvas = nullptr;
+    SkSize size;
+
+    SkCanvas* get() const
+    {
+        if (!canvas)
+        {
+            throw std::runtime_error("the canvas can only be used inside an on_draw callback");
+        }
+        return canvas;
+    }
+};
+
+SkPaint makePaint(uint32_t color, float strokeWidth, bool antiAlias)
+{
+    SkPaint paint;
+    paint.setColor(color);
+    paint.setAntiAlias(antiAlias);
+    if (strokeWidth > 0.0f)
+    {
+        paint.setStyle(SkPaint::kStroke_Style);
+        paint.setStrokeWidth(strokeWidth);
+    }
+    return paint;
+}
+
+SkCanvas::PointMode pointMode(const std::string& mode)
+{
+    if (mode == "points")
+    {
+        return SkCanvas::kPoints_PointMode;
+    }
+    if (mode == "lines")
+    {
+        return SkCanvas::kLines_PointMode;
+    }
+    if (mode == "polygon")
+    {
+        return SkCanvas::kPolygon_PointMode;
+    }
+    throw py::value_error("mode must be points, lines or polygon");
+}
+
+// Owns the flecs world of one editor instance, built exactly as the executable builds it
+struct Editor
+{
+    std::unique_ptr<flecs::world> ecs;
+    EditorOptions options;
+    bool finished = false;
+
+    Editor(const std::string& project, bool headless, const std::string& capture)
+    {
+        options.projectPath = project;
+        options.headless = headless;
+        if (!capture.empty())
+        {
+            options.capture.path = capture;
+            options.capture.format = captureFormatFromPath(capture);
+        }
+        ecs = std::make_unique<flecs::world>();
+        if (!buildEditor(*ecs, options))
+        {
+            throw std::runtime_error("the editor could not be built, see the log");
+        }
+    }
+
+    ~Editor()
+    {
+        close();
+    }
+
+    flecs::world& world()
+    {
+        if (finished)
+        {
+            throw std::runtime_error("the editor is closed");
+        }
+        return *ecs;
+    }
+
+    flecs::entity loop()
+    {
+        return world().lookup("loop");
+    }
+
+    flecs::entity clock()
+    {
+        return world().lookup("simulation");
+    }
+
+    // Errors raised by draw callbacks are held in the interpreter and raised here, flecs can't unwind
+    bool step()
+    {
+        bool running = stepEditor(world(), options);
+        if (PyErr_Occurred())
+        {
+            throw py::error_already_set();
+        }
+        return running;
+    }
+
+    void close()
+    {
+        if (!finished)
+        {
+            finishEditor(*ecs);
+            ecs.reset();
+            finished = true;
+        }
+    }
+
+    void onDraw(py::object draw)
+    {
+        auto script = world().entity("script");
+        if (draw.is_none())
+        {
+            script.remove<ScriptDraw>();
+            return;
+        }
+        script.set<ScriptDraw>({[draw](SkCanvas* canvas, SkSize size) {
+            if (PyErr_Occurred())
+            {
+                return;
+            }
+            auto wrapper = std::make_shared<Canvas>();
+            wrapper->canvas = canvas;
+            wrapper->size = size;
+            try
+            {
+                draw(wrapper);
+            }
+            catch (py::error_already_set& error)
+            {
+                error.restore();
+            }
+            wrapper->canvas = nullptr;
+        }});
+    }
+
+    size_t addMarkers(const float* x, const float* y, size_t count)
+    {
+        flecs::world& w = world();
+        for (size_t i = 0; i < count; i++)
+        {
+            w.entity().set<Marker>({{x[i], y[i]}});
+        }
+        return count;
+    }
+
+    flecs::entity_t addPolyline(const PointBuffer& points, float width, uint32_t color, std::pair<float, float> dash)
+    {
+        Polyline polyline;
+        buildPolyline(points, width, lineColor(color), {dash.first, dash.second}, polyline);
+        return world().entity().set<Polyline>(polyline).id();
+    }
+};
+
+PYBIND11_MODULE(paphos_native, m)
+{
+    m.doc() = "Native paphos editor: the flecs world, the Skia canvas and the geometry kernels";
+
+    py::class_<PointBuffer>(m, "PointBuffer",
+        "Structure-of-arrays points; x and y are NumPy views, not copies, and the size is fixed while any exist")
+        .def(py::init([](size_t count) {
+            PointBuffer points;
+            points.resize(count);
+            return points;
+        }), py::arg("count") = 0)
+        .def(py::init([](FloatArray x, FloatArray y) {
+            if (x.ndim() != 1 || y.ndim() != 1 || x.shape(0) != y.shape(0))
+            {
+                throw py::value_error("x and y must be 1D arrays of the same length");
+            }
+            PointBuffer points;
+            points.x.assign(x.data(), x.data() + x.shape(0));
+            points.y.assign(y.data(), y.data() + y.shape(0));
+            return points;
+        }), py::arg("x"), py::arg("y"))
+        .def("__len__", &PointBuffer::size)
+        .def("resize", [](PointBuffer& points, size_t count) {
+            checkResizable(points, count);
+            points.resize(count);
+        }, py::arg("count"), "Raises BufferError while x or y views exist")
+        .def_property_readonly("x", [](py::object self) { return laneView(self, self.cast<PointBuffer&>().x); })
+        .def_property_readonly("y", [](py::object self) { return laneView(self, self.cast<PointBuffer&>().y); });
+
+    py::class_<LogSpiral>(m, "LogSpiral")
+        .def(py::init<>())
+        .def_property("center",
+            [](const LogSpiral& s) { return std::make_pair(s.center.x, s.center.y); },
+            [](LogSpiral& s, std::pair<float, float> c) { s.center = {c.first, c.second}; })
+        .def_readwrite("a", &LogSpiral::a)
+        .def_readwrite("k", &LogSpiral::k)
+        .def_readwrite("phi_start", &LogSpiral::phiStart)
+        .def_readwrite("phi_step", &LogSpiral::phiStep)
+        .def_readwrite("count", &LogSpiral::count)
+        .def_readwrite("rotation", &LogSpiral::rotation)
+        .def_readwrite("turn_rate", &LogSpiral::turnRate);
+
+    m.def("evaluate_spiral", [](const LogSpiral& spiral, PointBuffer& points) {
+        checkResizable(points, spiral.count);
+        evaluateSpiral(spiral, points);
+    }, py::arg("spiral"), py::arg("points"));
+    m.def("posed_spiral", &posedSpiral, py::arg("spiral"), py::arg("loop_time"));
+    m.def("rotate", [](PointBuffer& points, float angle, std::pair<float, float> pivot) {
+        transformPoints(rotationAbout(angle, {pivot.first, pivot.second}),
+            points.x.data(), points.y.data(), points.x.data(), points.y.data(), points.size());
+    }, py::arg("points"), py::arg("angle"), py::arg("pivot"));
+    m.def("polyline_length", [](const PointBuffer& points) {
+        return polylineLength(points.x.data(), points.y.data(), points.size());
+    });
+    m.def("sample_polyline", [](const PointBuffer& points, float spacing, size_t maxCount) {
+        PointBuffer samples;
+        samples.resize(maxCount);
+        samples.resize(samplePolyline(points.x.data(), points.y.data(), points.size(), spacing,
+            samples.x.data(), samples.y.data(), maxCount));
+        return samples;
+    }, py::arg("points"), py::arg("spacing"), py::arg("max_count"));
+
+    py::class_<Canvas, std::shared_ptr<Canvas>>(m, "Canvas")
+        .def_property_readonly("width", [](const Canvas& c) { return c.size.width(); })
+        .def_property_readonly("height", [](const Canvas& c) { return c.size.height(); })
+        .def("clear", [](const Canvas& c, uint32_t color) { c.get()->clear(color); })
+        .def("draw_circle", [](const Canvas& c, float x, float y, float radius, uint32_t color, float strokeWidth, bool antiAlias) {
+            c.get()->drawCircle(x, y, radius, makePaint(color, strokeWidth, antiAlias));
+        }, py::arg("x"), py::arg("y"), py::arg("radius"), py::arg("color"), py::arg("stroke_width") = 0.0f, py::arg("anti_alias") = true)
+        .def("draw_line", [](const Canvas& c, float x0, float y0, float x1, float y1, uint32_t color, float strokeWidth, bool antiAlias) {
+            c.get()->drawLine(x0, y0, x1, y1, makePaint(color, strokeWidth, antiAlias));
+        }, py::arg("x0"), py::arg("y0"), py::arg("x1"), py::arg("y1"), py::arg("color"), py::arg("stroke_width") = 1.0f, py::arg("anti_alias") = true)
+        // Nx2 float32 arrays are handed to Skia as they are
+        .def("draw_points", [](const Canvas& c, FloatArray points, uint32_t color, const std::string& mode, float strokeWidth, bool antiAlias) {
+            size_t count;
+            const SkPoint* data = skiaPoints(points, count);
+            c.get()->drawPoints(pointMode(mode), count, data, makePaint(color, strokeWidth, antiAlias));
+        }, py::arg("points"), py::arg("color"), py::arg("mode") = "polygon", py::arg("stroke_width") = 1.0f, py::arg("anti_alias") = true)
+        .def("draw_points", [](const Canvas& c, const PointBuffer& points, uint32_t color, const std::string& mode, float strokeWidth, bool antiAlias) {
+            c.get()->drawPoints(pointMode(mode), points.size(), skiaPoints(points), makePaint(color, strokeWidth, antiAlias));
+        }, py::arg("points"), py::arg("color"), py::arg("mode") = "polygon", py::arg("stroke_width") = 1.0f, py::arg("anti_alias") = true)
+        .def("draw_path", [](const Canvas& c, const PointBuffer& points, uint32_t color, float strokeWidth, bool close, bool antiAlias) {
+            SkPath path;
+            path.addPoly(skiaPoints(points), static_cast<int>(points.size()), close);
+            c.get()->drawPath(path, makePaint(color, strokeWidth, antiAlias));
+        }, py::arg("points"), py::arg("color"), py::arg("stroke_width") = 1.0f, py::arg("close") = false, py::arg("anti_alias") = true);
+
+    py::class_<Editor>(m, "Editor")
+        .def(py::init<const std::string&, bool, const std::string&>(),
+            py::arg("project") = "", py::arg("headless") = false, py::arg("capture") = "")
+        .def("step", &Editor::step, "Runs one frame, False once the window has closed")
+        .def("close", &Editor::close, "Saves the project if one is open and destroys the world")
+        .def("on_draw", &Editor::onDraw, py::arg("callback"),
+            "callback(canvas) runs every frame after the built-in UI, None removes it")
+        .def_property("spiral",
+            [](Editor& e) { return *e.loop().get<LogSpiral>(); },
+            [](Editor& e, const LogSpiral& spiral) { e.loop().set<LogSpiral>(spiral); })
+        .def_property("play_rate",
+            [](Editor& e) { return e.clock().get<SimulationClock>()->playRate; },
+            [](Editor& e, float rate) { e.clock().get_mut<SimulationClock>()->playRate = rate; },
+            "Scales the simulation clock, 0 pauses it")
+        .def_property("loop_rate",
+            [](Editor& e) { return e.loop().get<LoopState>()->playRate; },
+            [](Editor& e, float rate) {
+                LoopState state = *e.loop().get<LoopState>();
+                state.playRate = rate;
+                e.loop().set<LoopState>(state);
+            },
+            "Multiplier of the loop's playback on top of play_rate")
+        .def_property_readonly("loop_progress", [](Editor& e) { return e.loop().get<LoopState>()->progress; })
+        .def("add_markers", [](Editor& e, const PointBuffer& points) {
+            return e.addMarkers(points.x.data(), points.y.data(), points.size());
+        }, py::arg("points"))
+        .def("add_markers", [](Editor& e, FloatArray x, FloatArray y) {
+            if (x.ndim() != 1 || y.ndim() != 1 || x.shape(0) != y.shape(0))
+            {
+                throw py::value_error("x and y must be 1D arrays of the same length");
+            }
+            return e.addMarkers(x.data(), y.data(), static_cast<size_t>(x.shape(0)));
+        }, py::arg("x"), py::arg("y"))
+        .def("add_polyline", &Editor::addPolyline, py::arg("points"), py::arg("width") = 1.0f,
+            py::arg("color") = 0xFFFFFFFFu, py::arg("dash") = std::make_pair(0.0f, 0.0f),
+            "Adds a GPU drawn polyline and returns its entity id")
+        // flecs asserts on 0 and on dead ids, which would abort the interpreter
+        .def("destroy", [](Editor& e, flecs::entity_t entity) {
+            if (entity == 0 || !ecs_is_alive(e.world().c_ptr(), entity))
+            {
+                throw py::value_error("no live entity " + std::to_string(entity));
+            }
+            flecs::entity(e.world(), entity).destruct();
+        }, py::arg("entity"))
+        .def("lookup", [](Editor& e, const std::string& name) {
+            flecs::entity entity = e.world().lookup(name.c_str());
+            if (!entity)
+            {
+                throw py::key_error(name);
+            }
+            return entity.id();
+        }, py::arg("name"));
+}
@@ -0,0 +1,27 @@
+# The paphos.py spiral drawn by the native renderer. Points are built by the C++ kernels into
+# NumPy-visible buffers and handed to Skia in one call, no per-point Python objects.
+import numpy as np
+import paphos_native as paphos
+
+editor = paphos.Editor()
+spiral = editor.spiral
+points = paphos.PointBuffer()
+
+# Scattered markers, pushed in one call
+rng = np.random.default_rng(7)
+editor.add_markers(rng.uniform(0, 800, 1000).astype(np.float32), rng.uniform(0, 600, 1000).astype(np.float32))
+
+def draw(canvas):
+    spiral.center = (canvas.width / 2, canvas.height / 2)
+    paphos.evaluate_spiral(paphos.posed_spiral(spiral, editor.loop_progress), points)
+    canvas.draw_path(points, 0x22666666, stroke_width=1.0)
+
+    # NumPy works on the same memory the native code filled
+    x, y = points.x, points.y
+    near = np.hypot(x - spiral.center[0], y - spiral.center[1]) < 128
+    canvas.draw_points(np.stack([x[near], y[near]], axis=1), 0xFF0F9D58, mode="points", stroke_width=3.0)
+
+editor.on_draw(draw)
+while editor.step():
+    pass
+editor.close()
@@ -1,2 +1,7 @@
 glslc shader.vert -o vert.spv
-glslc shader.frag -o frag.spv
\ No newline at end of file
+glslc shader.frag -o frag.spv
+glslc line.vert -o line_vert.spv
+glslc line.frag -o line_frag.spv
+glslc curve.comp -o curve_comp.spv
+glslc upscale.vert -o upscale_vert.spv
+glslc upscale.frag -o upscale_frag.spv
\ No newline at end of file
@@ -0,0 +1,27 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in float fragEdge;
+layout(location = 2) in float fragHalfWidth;
+layout(location = 3) in float fragDistance;
+layout(location = 4) flat in vec2 fragDash;
+
+layout(push_constant) uniform LinePushConstants {
+    vec2 viewport;
+    float scale;
+} line;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Signed distance to the stroke edge in target pixels gives analytic coverage
+    float coverage = clamp((fragHalfWidth - abs(fragEdge)) * line.scale + 0.5, 0.0, 1.0);
+    if (fragDash.y > 0.0) {
+        float phase = mod(fragDistance, fragDash.x + fragDash.y);
+        coverage *= clamp((fragDash.x - phase) * line.scale + 0.5, 0.0, 1.0) * clamp(phase * line.scale + 0.5, 0.0, 1.0);
+    }
+    if (coverage <= 0.0) {
+        discard;
+    }
+    outColor = vec4(fragColor.rgb, fragColor.a * coverage);
+}
\ No newline at end of file
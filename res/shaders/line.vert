@@ -0,0 +1,60 @@
+#version 450
+
+// One instance per segment, six vertices expand it into a quad padded for anti-aliasing
+layout(location = 0) in vec2 position0;
+layout(location = 1) in float distance0;
+layout(location = 2) in float width0;
+layout(location = 3) in vec4 color0;
+layout(location = 4) in vec2 dash0;
+layout(location = 5) in vec2 position1;
+layout(location = 6) in float distance1;
+layout(location = 7) in float width1;
+layout(location = 8) in vec4 color1;
+layout(location = 9) in vec2 dash1;
+
+layout(push_constant) uniform LinePushConstants {
+    vec2 viewport;
+    float scale;
+} line;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out float fragEdge;
+layout(location = 2) out float fragHalfWidth;
+layout(location = 3) out float fragDistance;
+layout(location = 4) flat out vec2 fragDash;
+
+const float FEATHER = 1.0;
+
+// x picks the segment end, y the side of the line
+const vec2 corners[6] = vec2[](
+    vec2(0.0, -1.0), vec2(0.0, 1.0), vec2(1.0, -1.0),
+    vec2(1.0, -1.0), vec2(0.0, 1.0), vec2(1.0, 1.0)
+);
+
+void main() {
+    // A zero width vertex ends a strip, so no segment starts from it
+    if (width0 <= 0.0) {
+        gl_Position = vec4(0.0);
+        return;
+    }
+    float endWidth = width1 > 0.0 ? width1 : width0;
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 delta = position1 - position0;
+    float len = length(delta);
+    vec2 dir = len > 0.0 ? delta / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+
+    float halfWidth = 0.5 * mix(width0, endWidth, corner.x);
+    // Pad by one target pixel, in window units like everything else here
+    float feather = FEATHER / line.scale;
+    float extent = halfWidth + feather;
+    float along = corner.x * 2.0 - 1.0;
+    vec2 pixel = mix(position0, position1, corner.x) + normal * corner.y * extent + dir * along * feather;
+
+    gl_Position = vec4(pixel / line.viewport * 2.0 - 1.0, 0.0, 1.0);
+    fragColor = mix(color0, color1, corner.x);
+    fragEdge = corner.y * extent;
+    fragHalfWidth = halfWidth;
+    fragDistance = mix(distance0, distance1, corner.x) + along * feather;
+    fragDash = dash0;
+}
\ No newline at end of file
@@ -1,9 +1,24 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+const uint NO_TEXTURE_SLOT = 0xFFFFFFFFu;
+
+layout(set = 0, binding = 0) uniform sampler bindlessSampler;
+layout(set = 0, binding = 1) uniform texture2D textures[];
+
+layout(push_constant) uniform DrawPushConstants {
+    uint textureIndex;
+} draw;
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    if (draw.textureIndex == NO_TEXTURE_SLOT) {
+        outColor = vec4(fragColor, 1.0);
+    } else {
+        outColor = texture(sampler2D(textures[nonuniformEXT(draw.textureIndex)], bindlessSampler), fragUV) * vec4(fragColor, 1.0);
+    }
 }
\ No newline at end of file
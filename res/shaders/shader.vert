@@ -1,6 +1,11 @@
 #version 450
 
+layout(push_constant) uniform DrawPushConstants {
+    uint textureIndex;
+} draw;
+
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
 
 vec2 positions[3] = vec2[](
     vec2(0.0, -0.5),
@@ -17,4 +22,5 @@ vec3 colors[3] = vec3[](
 void main() {
     gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
     fragColor = colors[gl_VertexIndex];
+    fragUV = positions[gl_VertexIndex] + vec2(0.5);
 }
\ No newline at end of file
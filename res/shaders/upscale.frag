@@ -0,0 +1,35 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform sampler bindlessSampler;
+layout(set = 0, binding = 1) uniform texture2D textures[];
+
+layout(push_constant) uniform UpscalePushConstants {
+    uint textureIndex;
+    float sharpness;
+    vec2 uvScale;
+} upscale;
+
+layout(location = 0) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+// Clamped to the rendered sub-rectangle so filtering never picks up stale texels beyond it
+vec4 fetch(vec2 uv, vec2 texel) {
+    uv = clamp(uv, vec2(0.0), upscale.uvScale - 0.5 * texel);
+    return texture(sampler2D(textures[nonuniformEXT(upscale.textureIndex)], bindlessSampler), uv);
+}
+
+void main() {
+    vec2 texel = 1.0 / vec2(textureSize(sampler2D(textures[nonuniformEXT(upscale.textureIndex)], bindlessSampler), 0));
+    vec4 center = fetch(fragUV, texel);
+    if (upscale.sharpness <= 0.0 || upscale.uvScale.x >= 1.0) {
+        outColor = center;
+        return;
+    }
+    // Bilinear upscaling softens edges, an unsharp mask over the source texel neighbourhood restores some contrast
+    vec4 neighbours = fetch(fragUV + vec2(texel.x, 0.0), texel) + fetch(fragUV - vec2(texel.x, 0.0), texel)
+                    + fetch(fragUV + vec2(0.0, texel.y), texel) + fetch(fragUV - vec2(0.0, texel.y), texel);
+    vec4 sharpened = center + (center - neighbours * 0.25) * upscale.sharpness;
+    outColor = clamp(sharpened, 0.0, 1.0);
+}
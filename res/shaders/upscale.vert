@@ -0,0 +1,17 @@
+#version 450
+
+layout(push_constant) uniform UpscalePushConstants {
+    uint textureIndex;
+    float sharpness;
+    vec2 uvScale;
+} upscale;
+
+layout(location = 0) out vec2 fragUV;
+
+// A single triangle covering the screen, no vertex buffer needed
+void main() {
+    vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    // Only the rendered sub-rectangle of the scene target holds this frame's image
+    fragUV = corner * upscale.uvScale;
+}
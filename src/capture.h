@@ -0,0 +1,253 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "components.h"
+#include "core/SkPixmap.h"
+#include "core/SkStream.h"
+#include "encode/SkPngEncoder.h"
+
+// A filled readback slot waiting to be written. Pixels stay in the mapped buffer until the writer is done.
+struct CaptureJob
+{
+    uint32_t slot;
+    uint64_t frame;
+    const uint8_t* pixels;
+};
+
+// Disk side of FrameCapture. Everything below runs on its own thread, the render loop only queues
+// jobs and takes back the slots that were written.
+struct CaptureWriter
+{
+    CaptureFormat format;
+    std::string path;
+    uint32_t width;
+    uint32_t height;
+    uint32_t framesPerSecond;
+    // Swapchain images are usually BGRA, the encoders need to know where red is
+    bool bgra;
+    std::ofstream stream;
+    std::vector<uint8_t> planes;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<CaptureJob> jobs;
+    std::vector<uint32_t> written;
+    bool stopping = false;
+    std::thread thread;
+    uint64_t framesWritten = 0;
+};
+
+CaptureFormat captureFormatFromPath(const std::string& path)
+{
+    auto endsWith = [&](const char* suffix) {
+        size_t length = strlen(suffix);
+        return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+    if (endsWith(".y4m"))
+    {
+        return CaptureFormat::Y4m;
+    }
+    if (endsWith(".png"))
+    {
+        return CaptureFormat::Png;
+    }
+    return CaptureFormat::Raw;
+}
+
+// Full range BT.601 4:2:0, what C420jpeg in the Y4M header promises
+void convertToI420(const CaptureWriter& writer, const uint8_t* pixels, uint8_t* planes)
+{
+    const uint32_t width = writer.width;
+    const uint32_t height = writer.height;
+    const uint32_t chromaWidth = (width + 1) / 2;
+    const uint32_t chromaHeight = (height + 1) / 2;
+    const int r = writer.bgra ? 2 : 0;
+    const int b = writer.bgra ? 0 : 2;
+    uint8_t* yPlane = planes;
+    uint8_t* uPlane = yPlane + width * height;
+    uint8_t* vPlane = uPlane + chromaWidth * chromaHeight;
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = pixels + static_cast<size_t>(y) * width * 4;
+        uint8_t* luma = yPlane + static_cast<size_t>(y) * width;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const uint8_t* p = row + x * 4;
+            luma[x] = static_cast<uint8_t>((77 * p[r] + 150 * p[1] + 29 * p[b] + 128) >> 8);
+        }
+    }
+
+    // Chroma is taken from the average of each 2x2 block, clamped at odd edges
+    for (uint32_t cy = 0; cy < chromaHeight; cy++)
+    {
+        const uint8_t* row0 = pixels + static_cast<size_t>(cy * 2) * width * 4;
+        const uint8_t* row1 = pixels + static_cast<size_t>(std::min(cy * 2 + 1, height - 1)) * width * 4;
+        for (uint32_t cx = 0; cx < chromaWidth; cx++)
+        {
+            uint32_t x0 = cx * 2 * 4;
+            uint32_t x1 = std::min(cx * 2 + 1, width - 1) * 4;
+            int red = row0[x0 + r] + row0[x1 + r] + row1[x0 + r] + row1[x1 + r];
+            int green = row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1];
+            int blue = row0[x0 + b] + row0[x1 + b] + row1[x0 + b] + row1[x1 + b];
+            size_t i = static_cast<size_t>(cy) * chromaWidth + cx;
+            uPlane[i] = static_cast<uint8_t>(std::clamp(((-43 * red - 85 * green + 128 * blue + 512) >> 10) + 128, 0, 255));
+            vPlane[i] = static_cast<uint8_t>(std::clamp(((128 * red - 107 * green - 21 * blue + 512) >> 10) + 128, 0, 255));
+        }
+    }
+}
+
+// capture.png becomes capture_000000.png, capture_000001.png, ...
+std::string pngFramePath(const std::string& path, uint64_t frame)
+{
+    char number[32];
+    snprintf(number, sizeof(number), "_%06llu", static_cast<unsigned long long>(frame));
+    return path.substr(0, path.size() - 4) + number + ".png";
+}
+
+void writeCaptureFrame(CaptureWriter& writer, const CaptureJob& job)
+{
+    const size_t frameBytes = static_cast<size_t>(writer.width) * writer.height * 4;
+    switch (writer.format)
+    {
+    case CaptureFormat::Raw:
+        writer.stream.write(reinterpret_cast<const char*>(job.pixels), frameBytes);
+        break;
+    case CaptureFormat::Y4m:
+        convertToI420(writer, job.pixels, writer.planes.data());
+        writer.stream << "FRAME\n";
+        writer.stream.write(reinterpret_cast<const char*>(writer.planes.data()), writer.planes.size());
+        break;
+    case CaptureFormat::Hash:
+    {
+        // FNV-1a over 64 bit words, odd trailing bytes are folded in one at a time
+        uint64_t hash = 14695981039346656037ull;
+        size_t words = frameBytes / sizeof(uint64_t);
+        for (size_t i = 0; i < words; i++)
+        {
+            uint64_t word;
+            memcpy(&word, job.pixels + i * sizeof(uint64_t), sizeof(uint64_t));
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        for (size_t i = words * sizeof(uint64_t); i < frameBytes; i++)
+        {
+            hash = (hash ^ job.pixels[i]) * 1099511628211ull;
+        }
+        char line[48];
+        snprintf(line, sizeof(line), "%llu %016llx\n", static_cast<unsigned long long>(job.frame), static_cast<unsigned long long>(hash));
+        writer.stream << line;
+        break;
+    }
+    case CaptureFormat::Png:
+    {
+        SkImageInfo info = SkImageInfo::Make(writer.width, writer.height,
+            writer.bgra ? kBGRA_8888_SkColorType : kRGBA_8888_SkColorType, kOpaque_SkAlphaType);
+        SkPixmap pixmap(info, job.pixels, writer.width * 4);
+        SkFILEWStream file(pngFramePath(writer.path, job.frame).c_str());
+        // Speed over size, PNG sequences are an intermediate format
+        SkPngEncoder::Options options;
+        options.fZLibLevel = 1;
+        if (!file.isValid() || !SkPngEncoder::Encode(&file, pixmap, options))
+        {
+            spdlog::error("Failed to write capture frame {}", job.frame);
+        }
+        break;
+    }
+    }
+    writer.framesWritten++;
+}
+
+void runCaptureWriter(CaptureWriter* writer)
+{
+    std::unique_lock<std::mutex> lock(writer->mutex);
+    while (true)
+    {
+        writer->wake.wait(lock, [&] { return writer->stopping || !writer->jobs.empty(); });
+        if (writer->jobs.empty())
+        {
+            break;
+        }
+        CaptureJob job = writer->jobs.front();
+        writer->jobs.pop_front();
+        lock.unlock();
+        writeCaptureFrame(*writer, job);
+        lock.lock();
+        writer->written.push_back(job.slot);
+    }
+    writer->stream.flush();
+}
+
+std::shared_ptr<CaptureWriter> startCaptureWriter(CaptureFormat format, const std::string& path,
+    uint32_t width, uint32_t height, uint32_t framesPerSecond, bool bgra)
+{
+    auto writer = std::make_shared<CaptureWriter>();
+    writer->format = format;
+    writer->path = path;
+    writer->width = width;
+    writer->height = height;
+    writer->framesPerSecond = framesPerSecond;
+    writer->bgra = bgra;
+
+    if (format != CaptureFormat::Png)
+    {
+        writer->stream.open(path, std::ios::binary | std::ios::trunc);
+        if (!writer->stream.is_open())
+        {
+            spdlog::error("Failed to open capture output {}", path);
+            return nullptr;
+        }
+    }
+    if (format == CaptureFormat::Y4m)
+    {
+        writer->planes.resize(static_cast<size_t>(width) * height + 2 * static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2));
+        writer->stream << "YUV4MPEG2 W" << width << " H" << height << " F" << framesPerSecond << ":1 Ip A1:1 C420jpeg\n";
+    }
+    if (format == CaptureFormat::Raw)
+    {
+        spdlog::info("Raw capture is {}x{} {} frames, 4 bytes per pixel", width, height, bgra ? "BGRA" : "RGBA");
+    }
+
+    writer->thread = std::thread(runCaptureWriter, writer.get());
+    return writer;
+}
+
+void queueCaptureFrame(CaptureWriter& writer, const CaptureJob& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        writer.jobs.push_back(job);
+    }
+    writer.wake.notify_one();
+}
+
+// Slots the writer has finished with since the last call
+void takeWrittenSlots(CaptureWriter& writer, std::vector<uint32_t>& slots)
+{
+    std::lock_guard<std::mutex> lock(writer.mutex);
+    slots.swap(writer.written);
+    writer.written.clear();
+}
+
+// Writes out every queued frame before returning
+void stopCaptureWriter(CaptureWriter& writer)
+{
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        writer.stopping = true;
+    }
+    writer.wake.notify_one();
+    if (writer.thread.joinable())
+    {
+        writer.thread.join();
+    }
+}
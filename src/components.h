@@ -2,11 +2,30 @@
 
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
+#include <flecs/flecs.h>
+#include <glm/vec2.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <functional>
 #include "gpu/GrDirectContext.h"
 #include "gpu/vk/GrVkBackendContext.h"
 #include "gpu/GrBackendSurface.h"
 #include "core/SkSurface.h"
 #include "core/SkRefCnt.h"
+#include "core/SkImageInfo.h"
+#include "core/SkCanvas.h"
+#include "private/chromium/GrVkSecondaryCBDrawContext.h"
+#include "private/chromium/GrDeferredDisplayList.h"
+#include "private/chromium/GrSurfaceCharacterization.h"
+
+// Sentinel push constant value for draws that sample no bindless texture
+constexpr uint32_t NO_TEXTURE_SLOT = UINT32_MAX;
+
+// Must match local_size_x in curve.comp
+constexpr uint32_t CURVE_WORKGROUP_SIZE = 64;
 
 struct PlatformFramework 
 {
@@ -24,6 +43,148 @@ struct RenderDevice
     VkDevice logical;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    // A compute-only family when the device has one, otherwise the graphics family
+    uint32_t computeFamily;
+    VkQueue computeQueue;
+    // Nanoseconds per timestamp tick, zero when the graphics queue can't write timestamps
+    float timestampPeriod;
+};
+
+// Free-list of indices into the bindless texture array
+struct TextureSlots
+{
+    uint32_t capacity;
+    uint32_t next;
+    std::vector<uint32_t> freed;
+};
+
+// Per-draw data pushed instead of binding a descriptor set per draw
+struct DrawPushConstants
+{
+    uint32_t textureIndex;
+};
+
+// A draw recorded into the cached per-image command buffers
+struct Drawable
+{
+    uint32_t vertexCount;
+    uint32_t textureIndex;
+};
+
+// One point of a GPU-expanded polyline. Segments run between consecutive vertices, a zero width
+// on the last vertex of a strip stops it joining the next, so any number of curves share one draw.
+struct LineVertex
+{
+    glm::vec2 position;
+    float distance; // arc length from the strip start, drives the dash pattern
+    float width;
+    uint32_t color; // R8G8B8A8 unorm
+    glm::vec2 dash; // on/off lengths in pixels, off == 0 is solid
+};
+
+struct Polyline
+{
+    std::vector<LineVertex> vertices;
+};
+
+// Push constants for the line pipeline. Positions, widths and viewport are in window units like
+// Skia, cursor and markers. scale is target pixels per window unit (content scale times the
+// scene's resolution scale), so anti-aliasing stays one target pixel wide.
+struct LinePushConstants
+{
+    glm::vec2 viewport;
+    float scale;
+};
+
+// Push constants for the pass that upscales the scene target into the swapchain image
+struct UpscalePushConstants
+{
+    uint32_t textureIndex;
+    float sharpness;
+    glm::vec2 uvScale;
+};
+
+// Push constants for one curve.comp dispatch, matching its std430 block
+struct CurvePushConstants
+{
+    glm::vec2 center;
+    float a;
+    float k;
+    float phiStart;
+    float phiStep;
+    float playRate;
+    float rotation;
+    float width;
+    uint32_t color;
+    uint32_t count;
+    uint32_t firstVertex;
+};
+
+struct GpuBuffer
+{
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+};
+
+// Change detection over everything that ends up in the recorded command buffers
+struct SceneChanges
+{
+    flecs::query<const Drawable> drawables;
+    flecs::query<const Polyline> polylines;
+};
+
+// CPU cost of recording and submitting frames, logged at debug level. Only the scene secondaries
+// are cached; the primary is recorded every frame since Skia draws into it, so recorded counts
+// scene re-recordings, not skipped frames.
+struct FrameTimings
+{
+    double recordSeconds;
+    double submitSeconds;
+    uint32_t frames;
+    uint32_t recorded;
+};
+
+// Animated curves generated on the GPU each frame into a vertex buffer drawn by the line pipeline
+struct CurveCompute
+{
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet set;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    // Signalled by the compute submit, waited on by the graphics submit before vertex input
+    VkSemaphore finishedSemaphore;
+    GpuBuffer vertices{};
+    uint32_t vertexCount = 0;
+    std::vector<CurvePushConstants> dispatches;
+};
+
+// Offscreen color target the scene renders into at a dynamic fraction of the swapchain size.
+// Allocated once at maxScale and rendered into a sub-rectangle, so scale changes never reallocate.
+struct SceneTarget
+{
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkExtent2D allocatedExtent{};
+    VkExtent2D renderExtent{};
+    uint32_t textureSlot = NO_TEXTURE_SLOT;
+
+    VkPipelineLayout upscalePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline upscalePipeline = VK_NULL_HANDLE;
+    // Per swapchain image, re-recorded with the scene command buffers
+    std::vector<VkCommandBuffer> upscaleCommandBuffers;
+
+    // Start and end timestamps of each frame's GPU work
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    bool timestampsWritten = false;
+    // Whether the scene secondaries currently record into this target
+    bool active = false;
 };
 
 struct Window
@@ -44,11 +205,35 @@ struct Window
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
+    // Bindless texture table, bound once per command buffer
+    VkDescriptorSetLayout bindlessLayout;
+    VkDescriptorPool bindlessPool;
+    VkDescriptorSet bindlessSet;
+    VkSampler bindlessSampler;
+    TextureSlots textureSlots;
+
     VkPipelineLayout pipelineLayout;
     VkRenderPass renderPass;
     VkPipeline graphicsPipeline;
+
+    // Every Polyline packed into one device-local vertex buffer, drawn instanced per segment
+    VkPipelineLayout linePipelineLayout;
+    VkPipeline linePipeline = VK_NULL_HANDLE;
+    GpuBuffer lineVertices{};
+    uint32_t lineVertexCount = 0;
+    CurveCompute curves;
+    SceneTarget sceneTarget;
+    float contentScale = 1.0f;
     VkCommandPool commandPool;
-    VkCommandBuffer commandBuffer;
+    uint32_t imageIndex;
+    // Per swapchain image: a primary that executes the scene and Skia secondaries inside renderPass,
+    // and a pre-recorded scene secondary re-recorded only when sceneVersion moves past recordedVersions
+    std::vector<VkCommandBuffer> commandBuffers;
+    std::vector<VkCommandBuffer> sceneCommandBuffers;
+    std::vector<uint64_t> recordedVersions;
+    uint64_t sceneVersion;
+    std::vector<Drawable> drawables;
+    FrameTimings frameTimings{};
 
     VkSemaphore imageAvailableSemaphore;
     VkSemaphore renderFinishedSemaphore;
@@ -56,12 +241,283 @@ struct Window
 
 };
 
+struct SkiaRecorderPool;
+
 struct SkiaGPU
 {
     sk_sp<GrDirectContext> vkContext;
-    // Use GrVkImageInfo to construct the following
-    // sk_sp<GrRenderTarget> renderTarget;
-    // GrBackendTexture* texture;
-    GrBackendRenderTarget* rt;
-    sk_sp<SkSurface> surface;
-};
\ No newline at end of file
+    SkImageInfo imageInfo;
+    // Canvas coordinates are window units, scaled to whichever target Skia records into
+    SkSize logicalSize;
+    // Skia draws are recorded into these secondary command buffers and executed in Window::renderPass
+    std::vector<VkCommandBuffer> commandBuffers;
+    VkRect2D drawBounds;
+    sk_sp<GrVkSecondaryCBDrawContext> drawContext;
+    // Kept alive until the frame that executed it has retired
+    sk_sp<GrVkSecondaryCBDrawContext> retiredContext;
+    // What layer recorders must match to be replayed into this frame's drawContext
+    GrSurfaceCharacterization characterization;
+    float canvasScale = 1.0f;
+    std::shared_ptr<SkiaRecorderPool> recorders;
+};
+
+// A UI panel or visualization, recorded on a worker thread into a deferred display list. Layers are
+// replayed over the scene in ascending order, however the recording was spread across threads.
+// record may only read the world.
+struct SkiaLayer
+{
+    int32_t order = 0;
+    std::function<void(SkCanvas*, SkSize)> record;
+    sk_sp<GrDeferredDisplayList> displayList;
+};
+
+struct SkiaLayers
+{
+    flecs::query<SkiaLayer> layers;
+    std::vector<SkiaLayer*> ordered;
+};
+
+// Logarithmic spiral r = a * e^(k * phi), sampled at phi = phiStart + i * phiStep and rotated about center.
+// The drawn spiral also turns by turnRate radians per second of loop time, see spiralAngle.
+struct LogSpiral
+{
+    glm::vec2 center;
+    float a;
+    float k;
+    float phiStart;
+    float phiStep;
+    uint32_t count;
+    float rotation;
+    float turnRate;
+};
+
+// Playback position of a loop, in seconds of loop time. Advanced once per simulation tick,
+// previousProgress holds the value before the latest tick for render interpolation.
+// playRate is this loop's multiplier on top of SimulationClock::playRate, which already scales
+// each tick's step, so 1 follows the clock and 0 holds this loop alone.
+struct LoopState
+{
+    float progress;
+    float previousProgress;
+    float playRate;
+};
+
+// Fixed-timestep clock. Wall-clock frame time is accumulated and spent in whole ticks, each running
+// the listed manual systems once with a step of tickSeconds * playRate. The tick count, and so the
+// simulation cost, doesn't depend on the play rate, and maxTicksPerFrame only limits the catch-up
+// after a stall. alpha is how far rendering is past the last tick.
+struct SimulationClock
+{
+    double tickSeconds = 1.0 / 120.0;
+    uint32_t maxTicksPerFrame = 8;
+    float playRate = 1.0f;
+    double accumulator = 0.0;
+    double time = 0.0;
+    uint64_t tick = 0;
+    float alpha = 0.0f;
+    std::vector<flecs::entity_t> systems;
+};
+
+// Spiral sample closest to the loop radius
+struct SpiralIndicator
+{
+    float radius;
+    uint32_t index;
+    glm::vec2 position;
+};
+
+struct Marker
+{
+    glm::vec2 position;
+};
+
+struct MarkerEntry
+{
+    glm::vec2 position;
+    flecs::entity_t marker;
+};
+
+// Cell a marker is filed under
+struct MarkerCellRef
+{
+    uint64_t cell;
+    bool indexed;
+};
+
+// Uniform hash grid over Marker positions, kept current by observers
+struct MarkerIndex
+{
+    float cellSize;
+    std::unordered_map<uint64_t, std::vector<MarkerEntry>> cells;
+    // Indexed by the low 32 bits of the entity id, which flecs allocates densely. Unlike a hash map
+    // this can be filled for millions of markers at load time with plain stores.
+    std::vector<MarkerCellRef> cellOf;
+};
+
+struct Hover
+{
+    float radius;
+    flecs::entity_t marker;
+    // Spiral sample under the cursor, when no marker is
+    bool onSpiral;
+    uint32_t spiralIndex;
+    glm::vec2 spiralPosition;
+};
+
+// Feedback controller that trades scene resolution for GPU frame time. Layers opt out of scaling
+// individually: the scene is scaled by default, the Skia UI stays at native resolution.
+struct DynamicResolution
+{
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float targetMilliseconds = 14.0f;
+    float sharpness = 0.2f;
+    bool scaleScene = true;
+    bool scaleUi = false;
+    float scale = 1.0f;
+    float gpuMilliseconds = 0.0f;
+    // Frames left before the next adjustment, so the smoothed time can catch up with the last one
+    uint32_t cooldown = 0;
+};
+
+enum class CaptureFormat
+{
+    Raw,
+    Y4m,
+    Png,
+    // One FNV-1a hash per frame as text, for comparing replays
+    Hash,
+};
+
+enum class CaptureSlotState
+{
+    Free,
+    // Copy submitted, waiting on the slot fence
+    InFlight,
+    // Handed to the writer thread, which frees it once written
+    Writing,
+};
+
+// One host-visible readback buffer in the capture ring, persistently mapped
+struct CaptureSlot
+{
+    GpuBuffer buffer{};
+    void* mapped = nullptr;
+    VkFence fence = VK_NULL_HANDLE;
+    uint64_t frame = 0;
+    CaptureSlotState state = CaptureSlotState::Free;
+};
+
+struct CaptureWriter;
+
+// Copies every presented image into a ring of readback buffers. Frames are collected once their
+// fences signal, several frames later, and streamed to disk by a writer thread. When the ring is
+// full the frame is dropped rather than stalling the renderer.
+struct FrameCapture
+{
+    std::string path;
+    CaptureFormat format = CaptureFormat::Raw;
+    uint32_t ringSize = 6;
+    uint32_t framesPerSecond = 60;
+    std::vector<CaptureSlot> slots;
+    std::shared_ptr<CaptureWriter> writer;
+    // Waits for a slot instead of dropping, for replays where every frame must be written
+    bool lossless = false;
+    uint64_t frame = 0;
+    uint64_t dropped = 0;
+    // Time spent waiting for slots since the replay last took it out of its frame times
+    float stalledMilliseconds = 0.0f;
+};
+
+// Runs the platform without a display, through GLFW's null platform and a headless Vulkan surface
+struct Headless {};
+
+enum class InputEventType : uint8_t
+{
+    CursorPos,
+    MouseButton,
+    Key,
+    Scroll,
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    uint8_t action;
+    uint8_t mods;
+    int32_t code;
+    glm::vec2 value;
+};
+
+// Input as the systems see it for the current frame, whether it came from GLFW or a replayed log.
+// Button masks are indexed by GLFW mouse button.
+struct InputState
+{
+    glm::vec2 cursor{};
+    glm::vec2 scroll{};
+    uint32_t buttons = 0;
+    uint32_t pressed = 0;
+    uint32_t released = 0;
+    // Key presses and repeats this frame
+    std::vector<InputEvent> keys;
+    // Filled by the GLFW callbacks through the window user pointer, so it lives on the heap
+    std::shared_ptr<std::vector<InputEvent>> queue = std::make_shared<std::vector<InputEvent>>();
+};
+
+enum class InputMode
+{
+    Live,
+    Record,
+    Replay,
+};
+
+struct InputLogWriter;
+struct InputLogReader;
+
+// Records every frame's input and delta time, or replays a recording in place of GLFW input.
+// Replays collect per-frame times for a report once the log runs out.
+struct InputSession
+{
+    InputMode mode = InputMode::Live;
+    std::string reportPath;
+    std::shared_ptr<InputLogWriter> writer;
+    std::shared_ptr<InputLogReader> reader;
+    std::vector<float> frameMilliseconds;
+    // Lossless capture waits left out of frameMilliseconds, so hashed and plain runs compare
+    double captureStallMilliseconds = 0.0;
+    std::chrono::steady_clock::time_point lastFrame{};
+    bool finished = false;
+};
+
+// Append-only binary snapshot of the user's loop, markers and polylines. Tracks what changed since
+// the last save so saving appends only that, and compacts the file once superseded sections dominate it.
+struct ProjectSnapshot
+{
+    std::string path;
+    flecs::query<const Polyline> polylines;
+    // Markers created since the last save, written as an append section
+    std::unordered_set<flecs::entity_t> addedMarkers;
+    // Set when a saved marker moved or was removed, so the next save writes every marker again
+    bool rewriteMarkers = false;
+    uint64_t markersInFullSection = 0;
+    uint64_t markersAppended = 0;
+    LogSpiral savedSpiral{};
+    LoopState savedLoop{};
+    bool loopSaved = false;
+    uint64_t fileBytes = 0;
+};
+// Periodically logs how much host memory the driver allocated per frame, to catch churn in the render loop
+struct HostMemoryReport
+{
+    uint32_t intervalFrames = 600;
+    uint32_t frames = 0;
+    uint64_t lastAllocations = 0;
+    uint64_t lastCommandAllocations = 0;
+};
+
+// Draws into the Skia canvas every frame after the built-in UI, in window units. Lets code outside
+// the systems, such as Python prototypes, draw with the native renderer.
+struct ScriptDraw
+{
+    std::function<void(SkCanvas*, SkSize)> draw;
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <flecs/flecs.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include "systems.h"
+#include "components.h"
+
+// Everything the command line, or a script embedding the editor, decides before the world is built
+struct EditorOptions
+{
+    FrameCapture capture;
+    InputSession session;
+    std::string recordPath;
+    std::string projectPath;
+    bool headless = false;
+};
+
+// Registers every system and observer and creates the core, window and loop entities.
+// Returns false when the options can't be honoured, the world should then be dropped unstepped.
+bool buildEditor(flecs::world& ecs, EditorOptions& options)
+{
+    // Replays must not open a window, one that can take focus or input would change the run
+    bool headless = options.headless || options.session.mode == InputMode::Replay;
+#ifndef GLFW_PLATFORM_NULL
+    if (headless)
+    {
+        spdlog::error("Headless mode and replays need GLFW 3.4 or newer");
+        return false;
+    }
+#endif
+
+    // ecs.set_threads(FLECS_THREAD_COUNT);
+
+    ecs.trigger<PlatformFramework>().event(flecs::OnAdd).each(SetupFramework);
+    ecs.trigger<Window>().event(flecs::OnAdd).each(CreateWindow);
+
+    ecs.system<PlatformFramework>().kind(flecs::PreUpdate).iter(PollEvents);
+    ecs.trigger<InputState>().event(flecs::OnAdd).each(ListenForInput);
+    ecs.system<InputState, InputSession, const Window, FrameCapture>().kind(flecs::PreUpdate).iter(ApplyInput);
+
+    // Simulation systems are manual (kind 0) and only run from StepSimulation at the fixed tick
+    SimulationClock clock;
+    clock.systems.push_back(ecs.system<LoopState>().kind(0).iter(AdvanceLoop).id());
+    ecs.entity("simulation").set<SimulationClock>(clock);
+    ecs.system<SimulationClock>().kind(flecs::PreUpdate).iter(StepSimulation);
+
+    ecs.system<Window>().iter(CloseWindow);
+
+    auto platform = ecs.entity("core");
+    if (headless)
+    {
+        platform.add<Headless>();
+    }
+    platform
+        .add<PlatformFramework>()
+        .add<RenderDevice>()
+        .add<SkiaGPU>()
+        .add<HostMemoryReport>()
+        .set<SkiaLayers>({ecs.query<SkiaLayer>()});
+
+    auto window = ecs.entity("window").add<Window>();
+    window.set<SceneChanges>({ecs.query<const Drawable>(), ecs.query<const Polyline>()});
+    window.add<InputState>();
+    if (!options.recordPath.empty())
+    {
+        int width, height;
+        glfwGetWindowSize(window.get<Window>()->object, &width, &height);
+        options.session.writer = openInputRecording(options.recordPath, width, height);
+        options.session.mode = options.session.writer ? InputMode::Record : InputMode::Live;
+    }
+    if (options.session.mode == InputMode::Replay)
+    {
+        int width, height;
+        glfwGetWindowSize(window.get<Window>()->object, &width, &height);
+        if (static_cast<uint32_t>(width) != options.session.reader->width || static_cast<uint32_t>(height) != options.session.reader->height)
+        {
+            spdlog::warn("Input log was recorded at {}x{}, replaying at {}x{}", options.session.reader->width, options.session.reader->height, width, height);
+        }
+    }
+    window.set<InputSession>(options.session);
+
+    // GPU timing feedback would make replays differ from run to run, so they render at a fixed scale
+    DynamicResolution resolution;
+    if (options.session.mode == InputMode::Replay)
+    {
+        resolution.minScale = resolution.maxScale;
+    }
+    window.set<DynamicResolution>(resolution);
+    window.set<FrameCapture>(options.capture);
+
+    ecs.entity("triangle").set<Drawable>({3, NO_TEXTURE_SLOT});
+
+    auto loop = ecs.entity("loop")
+        .set<LogSpiral>({{400.0f, 300.0f}, 1.0f, 0.2f, 1.0f, 0.1f, 500, 0.0f, -TWO_PI / 8.0f})
+        .set<LoopState>({0.0f, 0.0f, 1.0f})
+        .set<SpiralIndicator>({128.0f})
+        .set<MarkerIndex>({16.0f})
+        .set<Hover>({16.0f});
+
+    // Recorded in parallel each frame, replayed lowest order first
+    ecs.entity("ring").set<SkiaLayer>({0, recordGuideRing});
+    // Markers are split by cell row over as many layers as there are recording threads
+    uint32_t markerLayers = std::clamp<uint32_t>(std::thread::hardware_concurrency(), 1, FLECS_THREAD_COUNT);
+    for (uint32_t shard = 0; shard < markerLayers; shard++)
+    {
+        ecs.entity().set<SkiaLayer>({1, [loop, shard, markerLayers](SkCanvas* canvas, SkSize size) {
+            recordMarkers(loop, shard, markerLayers, canvas, size);
+        }});
+    }
+    ecs.entity("overlay").set<SkiaLayer>({2, [loop](SkCanvas* canvas, SkSize size) { recordLoopOverlay(loop, canvas, size); }});
+
+    // Loaded markers are indexed in bulk, so this has to happen before the marker observers exist
+    if (!options.projectPath.empty())
+    {
+        ProjectSnapshot snapshot;
+        snapshot.path = options.projectPath;
+        snapshot.polylines = ecs.query<const Polyline>();
+        // Saving would replace a file that failed to load, whatever it holds
+        if (!loadSnapshot(ecs, loop, snapshot))
+        {
+            spdlog::error("Not opening {}, it would be overwritten on save", snapshot.path);
+            return false;
+        }
+        loop.set<ProjectSnapshot>(snapshot);
+
+        ecs.observer<const Marker>()
+            .term<ProjectSnapshot>().subj("loop")
+            .event(flecs::OnAdd)
+            .iter(TrackAddedMarkers);
+
+        ecs.observer<const Marker>()
+            .term<ProjectSnapshot>().subj("loop")
+            .event(flecs::OnSet)
+            .iter(TrackChangedMarkers);
+
+        ecs.observer<const Marker>()
+            .term<ProjectSnapshot>().subj("loop")
+            .event(flecs::OnRemove)
+            .iter(TrackRemovedMarkers);
+
+        ecs.system<ProjectSnapshot>()
+            .term<InputState>().subj("window")
+            .iter(SaveProject);
+    }
+
+    // Marker and spiral edits can be undone. LoopState is left out, it changes every tick.
+    auto history = ecs.entity("history").add<EditHistory>();
+    trackHistory<Marker>(ecs, history);
+    trackHistory<LogSpiral>(ecs, history);
+
+    ecs.system<EditHistory>()
+        .term<InputState>().subj("window")
+        .iter(UndoRedo);
+
+    ecs.system<EditHistory>().kind(flecs::PostFrame).iter(CommitHistory);
+
+    ecs.observer<const Marker>()
+        .term<MarkerIndex>().subj("loop")
+        .event(flecs::OnSet)
+        .iter(IndexMarker);
+
+    ecs.observer<const Marker>()
+        .term<MarkerIndex>().subj("loop")
+        .event(flecs::OnRemove)
+        .iter(UnindexMarker);
+
+    ecs.observer<Window>()
+        .term<PlatformFramework>().subj("core")
+        .term<RenderDevice>().subj("core")
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateWindowSurface);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(SelectPrimaryRenderDevice);
+
+    ecs.observer<PlatformFramework, RenderDevice>().event(flecs::OnAdd).yield_existing().each(SpecifyLogicalDevice);
+    
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateSwapChain);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateRenderPass);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateBindlessTextureTable);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateGraphicsPipeline);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateLinePipeline);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateFramebuffers);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateCommandPool);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .term<DynamicResolution>().subj("window")
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateSceneTarget);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window")
+        .term<FrameCapture>().subj("window")
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateFrameCapture);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateSyncObjects);
+
+    ecs.observer<PlatformFramework, RenderDevice>()
+        .term<Window>().subj("window").read_write()
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateCurveCompute);
+
+    ecs.observer<PlatformFramework, RenderDevice, SkiaGPU>()
+        .term<Window>().subj("window")
+        .event(flecs::OnAdd)
+        .yield_existing()
+        .iter(CreateSkiaSurface);
+
+    ecs.observer<Window>()
+        .term<PlatformFramework>().subj("core")
+        .term<RenderDevice>().subj("core")
+        .term<SkiaGPU>().subj("core")
+        .term<FrameCapture>().subj("window")
+        .event(flecs::OnRemove)
+        .iter(DestroyWindowSurface);
+
+    ecs.observer<PlatformFramework, RenderDevice>().event(flecs::OnRemove).each(ShutdownFramework);
+    ecs.trigger<Window>().event(flecs::OnRemove).each(DestroyWindow);
+
+    ecs.system<const LogSpiral, const LoopState, SpiralIndicator>()
+        .term<SimulationClock>().subj("simulation")
+        .iter(UpdateSpiralIndicator);
+
+    ecs.system<const MarkerIndex, Hover>()
+        .term<InputState>().subj("window")
+        .iter(HoverMarkers);
+
+    ecs.system<const LogSpiral, const LoopState, Hover>()
+        .term<SimulationClock>().subj("simulation")
+        .term<InputState>().subj("window")
+        .iter(HoverSpiral);
+
+    ecs.system<PlatformFramework, RenderDevice, SkiaGPU>()
+        .term<Window>().subj("window").read_write()
+        .term<DynamicResolution>().subj("window").read_write()
+        .iter(BeginFrame);
+
+    ecs.system<Window, SceneChanges>()
+        .term<RenderDevice>().subj("core")
+        .iter(TrackSceneChanges);
+
+    ecs.system<SkiaGPU, SkiaLayers>()
+        .iter(RecordSkiaLayers);
+
+    ecs.system<const ScriptDraw>()
+        .term<SkiaGPU>().subj("core")
+        .iter(DrawScripts);
+
+    ecs.system<const LogSpiral, const LoopState>()
+        .term<Window>().subj("window").read_write()
+        .term<SimulationClock>().subj("simulation")
+        .iter(CollectCurves);
+
+    ecs.system<PlatformFramework, RenderDevice, SkiaGPU>()
+        .term<Window>().subj("window").read_write()
+        .term<DynamicResolution>().subj("window")
+        .term<FrameCapture>().subj("window")
+        .iter(RenderFrame);
+
+    ecs.system<FrameCapture>()
+        .term<RenderDevice>().subj("core")
+        .iter(CollectCapturedFrames);
+
+    ecs.system<HostMemoryReport>()
+        .iter(ReportHostMemory);
+    return true;
+}
+
+// Replays step each frame by its recorded delta time, so the fixed-step simulation ticks exactly as it did live
+bool stepEditor(flecs::world& ecs, const EditorOptions& options)
+{
+    const InputSession& session = options.session;
+    ecs.progress(session.reader ? peekInputFrameDelta(*session.reader) : 0.0f);
+    auto history = ecs.lookup("history");
+    if (history)
+    {
+        applyHistoryRequest(ecs, *history.get_mut<EditHistory>());
+    }
+    return !ecs.should_quit();
+}
+
+void finishEditor(flecs::world& ecs)
+{
+    auto loop = ecs.lookup("loop");
+    if (loop && loop.has<ProjectSnapshot>())
+    {
+        saveSnapshot(loop, *loop.get_mut<ProjectSnapshot>());
+    }
+}
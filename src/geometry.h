@@ -0,0 +1,310 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/mat3x3.hpp>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "components.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Structure-of-arrays points so the kernels below can load whole lanes of x and y
+struct PointBuffer
+{
+    std::vector<float> x;
+    std::vector<float> y;
+
+    size_t size() const { return x.size(); }
+    void resize(size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+    }
+};
+
+// Thin lane wrappers, widest instruction set the build enables wins
+namespace simd
+{
+#if defined(__AVX2__)
+    constexpr size_t WIDTH = 8;
+    using Lane = __m256;
+    inline Lane load(const float* p) { return _mm256_loadu_ps(p); }
+    inline void store(float* p, Lane v) { _mm256_storeu_ps(p, v); }
+    inline Lane set1(float v) { return _mm256_set1_ps(v); }
+    inline Lane add(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+    inline Lane sub(Lane a, Lane b) { return _mm256_sub_ps(a, b); }
+    inline Lane mul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+    inline Lane sqrt(Lane a) { return _mm256_sqrt_ps(a); }
+#if defined(__FMA__)
+    inline Lane madd(Lane a, Lane b, Lane c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+    inline Lane madd(Lane a, Lane b, Lane c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+    inline float sum(Lane v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    constexpr size_t WIDTH = 4;
+    using Lane = __m128;
+    inline Lane load(const float* p) { return _mm_loadu_ps(p); }
+    inline void store(float* p, Lane v) { _mm_storeu_ps(p, v); }
+    inline Lane set1(float v) { return _mm_set1_ps(v); }
+    inline Lane add(Lane a, Lane b) { return _mm_add_ps(a, b); }
+    inline Lane sub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+    inline Lane mul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+    inline Lane sqrt(Lane a) { return _mm_sqrt_ps(a); }
+    inline Lane madd(Lane a, Lane b, Lane c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    inline float sum(Lane v)
+    {
+        __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+#elif defined(__ARM_NEON)
+    constexpr size_t WIDTH = 4;
+    using Lane = float32x4_t;
+    inline Lane load(const float* p) { return vld1q_f32(p); }
+    inline void store(float* p, Lane v) { vst1q_f32(p, v); }
+    inline Lane set1(float v) { return vdupq_n_f32(v); }
+    inline Lane add(Lane a, Lane b) { return vaddq_f32(a, b); }
+    inline Lane sub(Lane a, Lane b) { return vsubq_f32(a, b); }
+    inline Lane mul(Lane a, Lane b) { return vmulq_f32(a, b); }
+    inline Lane madd(Lane a, Lane b, Lane c) { return vmlaq_f32(c, a, b); }
+#if defined(__aarch64__)
+    inline Lane sqrt(Lane a) { return vsqrtq_f32(a); }
+    inline float sum(Lane v) { return vaddvq_f32(v); }
+#else
+    inline Lane sqrt(Lane a)
+    {
+        float v[4];
+        vst1q_f32(v, a);
+        for (float& f : v) f = std::sqrt(f);
+        return vld1q_f32(v);
+    }
+    inline float sum(Lane v)
+    {
+        float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpadd_f32(s, s), 0);
+    }
+#endif
+#else
+    constexpr size_t WIDTH = 1;
+    using Lane = float;
+    inline Lane load(const float* p) { return *p; }
+    inline void store(float* p, Lane v) { *p = v; }
+    inline Lane set1(float v) { return v; }
+    inline Lane add(Lane a, Lane b) { return a + b; }
+    inline Lane sub(Lane a, Lane b) { return a - b; }
+    inline Lane mul(Lane a, Lane b) { return a * b; }
+    inline Lane madd(Lane a, Lane b, Lane c) { return a * b + c; }
+    inline Lane sqrt(Lane a) { return std::sqrt(a); }
+    inline float sum(Lane v) { return v; }
+#endif
+}
+
+// Writes center + a * e^(k * phi) * (cos phi, sin phi) for phi = phiStart + i * phiStep.
+// Consecutive samples differ by the constant complex factor e^((k + i) * phiStep), so lanes advance
+// by complex multiplication and are re-seeded exactly every RESEED_INTERVAL vectors to bound drift.
+void evaluateLogSpiral(float a, float k, float phiStart, float phiStep, size_t count, glm::vec2 center, float* x, float* y)
+{
+    constexpr size_t RESEED_INTERVAL = 16;
+    const float stepScale = std::exp(k * phiStep * simd::WIDTH);
+    const simd::Lane stepCos = simd::set1(stepScale * std::cos(phiStep * simd::WIDTH));
+    const simd::Lane stepSin = simd::set1(stepScale * std::sin(phiStep * simd::WIDTH));
+    const simd::Lane cx = simd::set1(center.x);
+    const simd::Lane cy = simd::set1(center.y);
+
+    size_t i = 0;
+    float seedX[simd::WIDTH];
+    float seedY[simd::WIDTH];
+    for (size_t vector = 0; i + simd::WIDTH <= count; vector++, i += simd::WIDTH)
+    {
+        simd::Lane re, im;
+        if (vector % RESEED_INTERVAL == 0)
+        {
+            for (size_t lane = 0; lane < simd::WIDTH; lane++)
+            {
+                float phi = phiStart + (i + lane) * phiStep;
+                float r = a * std::exp(k * phi);
+                seedX[lane] = r * std::cos(phi);
+                seedY[lane] = r * std::sin(phi);
+            }
+            re = simd::load(seedX);
+            im = simd::load(seedY);
+        }
+        else
+        {
+            simd::Lane prevRe = simd::sub(simd::load(x + i - simd::WIDTH), cx);
+            simd::Lane prevIm = simd::sub(simd::load(y + i - simd::WIDTH), cy);
+            re = simd::sub(simd::mul(prevRe, stepCos), simd::mul(prevIm, stepSin));
+            im = simd::madd(prevRe, stepSin, simd::mul(prevIm, stepCos));
+        }
+        simd::store(x + i, simd::add(re, cx));
+        simd::store(y + i, simd::add(im, cy));
+    }
+    for (; i < count; i++)
+    {
+        float phi = phiStart + i * phiStep;
+        float r = a * std::exp(k * phi);
+        x[i] = center.x + r * std::cos(phi);
+        y[i] = center.y + r * std::sin(phi);
+    }
+}
+
+// Applies an affine 2D transform (glm column-major, third column is translation), in place is fine
+void transformPoints(const glm::mat3& m, const float* xIn, const float* yIn, float* xOut, float* yOut, size_t count)
+{
+    const simd::Lane m00 = simd::set1(m[0][0]), m01 = simd::set1(m[0][1]);
+    const simd::Lane m10 = simd::set1(m[1][0]), m11 = simd::set1(m[1][1]);
+    const simd::Lane m20 = simd::set1(m[2][0]), m21 = simd::set1(m[2][1]);
+    size_t i = 0;
+    for (; i + simd::WIDTH <= count; i += simd::WIDTH)
+    {
+        simd::Lane px = simd::load(xIn + i);
+        simd::Lane py = simd::load(yIn + i);
+        simd::store(xOut + i, simd::madd(px, m00, simd::madd(py, m10, m20)));
+        simd::store(yOut + i, simd::madd(px, m01, simd::madd(py, m11, m21)));
+    }
+    for (; i < count; i++)
+    {
+        float px = xIn[i];
+        float py = yIn[i];
+        xOut[i] = px * m[0][0] + py * m[1][0] + m[2][0];
+        yOut[i] = px * m[0][1] + py * m[1][1] + m[2][1];
+    }
+}
+
+// Rotation by angle about pivot, as skia::Matrix::setRotate does for the prototype
+glm::mat3 rotationAbout(float angle, glm::vec2 pivot)
+{
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    glm::mat3 m(1.0f);
+    m[0][0] = c;
+    m[0][1] = s;
+    m[1][0] = -s;
+    m[1][1] = c;
+    m[2][0] = pivot.x - c * pivot.x + s * pivot.y;
+    m[2][1] = pivot.y - s * pivot.x - c * pivot.y;
+    return m;
+}
+
+// Length of segment i (points i to i + 1) into lengths[i], count - 1 values
+void segmentLengths(const float* x, const float* y, size_t count, float* lengths)
+{
+    if (count < 2)
+    {
+        return;
+    }
+    size_t segments = count - 1;
+    size_t i = 0;
+    for (; i + simd::WIDTH <= segments; i += simd::WIDTH)
+    {
+        simd::Lane dx = simd::sub(simd::load(x + i + 1), simd::load(x + i));
+        simd::Lane dy = simd::sub(simd::load(y + i + 1), simd::load(y + i));
+        simd::store(lengths + i, simd::sqrt(simd::madd(dx, dx, simd::mul(dy, dy))));
+    }
+    for (; i < segments; i++)
+    {
+        float dx = x[i + 1] - x[i];
+        float dy = y[i + 1] - y[i];
+        lengths[i] = std::sqrt(dx * dx + dy * dy);
+    }
+}
+
+float polylineLength(const float* x, const float* y, size_t count)
+{
+    if (count < 2)
+    {
+        return 0.0f;
+    }
+    size_t segments = count - 1;
+    simd::Lane total = simd::set1(0.0f);
+    size_t i = 0;
+    for (; i + simd::WIDTH <= segments; i += simd::WIDTH)
+    {
+        simd::Lane dx = simd::sub(simd::load(x + i + 1), simd::load(x + i));
+        simd::Lane dy = simd::sub(simd::load(y + i + 1), simd::load(y + i));
+        total = simd::add(total, simd::sqrt(simd::madd(dx, dx, simd::mul(dy, dy))));
+    }
+    float length = simd::sum(total);
+    for (; i < segments; i++)
+    {
+        float dx = x[i + 1] - x[i];
+        float dy = y[i + 1] - y[i];
+        length += std::sqrt(dx * dx + dy * dy);
+    }
+    return length;
+}
+
+// Resamples a polyline at equal arc-length spacing, returns the number of points written (at most maxCount)
+size_t samplePolyline(const float* x, const float* y, size_t count, float spacing, float* outX, float* outY, size_t maxCount)
+{
+    if (count == 0 || maxCount == 0 || spacing <= 0.0f)
+    {
+        return 0;
+    }
+    std::vector<float> lengths(count > 1 ? count - 1 : 0);
+    segmentLengths(x, y, count, lengths.data());
+
+    size_t written = 0;
+    float target = 0.0f;
+    float travelled = 0.0f;
+    for (size_t segment = 0; segment + 1 < count && written < maxCount; segment++)
+    {
+        float length = lengths[segment];
+        while (target <= travelled + length && written < maxCount)
+        {
+            float t = length > 0.0f ? (target - travelled) / length : 0.0f;
+            outX[written] = x[segment] + (x[segment + 1] - x[segment]) * t;
+            outY[written] = y[segment] + (y[segment + 1] - y[segment]) * t;
+            written++;
+            target += spacing;
+        }
+        travelled += length;
+    }
+    if (written == 0)
+    {
+        outX[0] = x[0];
+        outY[0] = y[0];
+        written = 1;
+    }
+    return written;
+}
+
+// Samples and rotates the whole spiral in two batched passes
+void evaluateSpiral(const LogSpiral& spiral, PointBuffer& points)
+{
+    points.resize(spiral.count);
+    evaluateLogSpiral(spiral.a, spiral.k, spiral.phiStart, spiral.phiStep, spiral.count, spiral.center, points.x.data(), points.y.data());
+    transformPoints(rotationAbout(spiral.rotation, spiral.center), points.x.data(), points.y.data(), points.x.data(), points.y.data(), spiral.count);
+}
+
+// Line vertices for points, with the running arc length the dash pattern needs
+void buildPolyline(const PointBuffer& points, float width, uint32_t color, glm::vec2 dash, Polyline& polyline)
+{
+    size_t count = points.size();
+    std::vector<float> lengths(count > 1 ? count - 1 : 0);
+    segmentLengths(points.x.data(), points.y.data(), count, lengths.data());
+    polyline.vertices.resize(count);
+    float distance = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        polyline.vertices[i] = {{points.x[i], points.y[i]}, distance, width, color, dash};
+        if (i < lengths.size())
+        {
+            distance += lengths[i];
+        }
+    }
+}
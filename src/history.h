@@ -0,0 +1,560 @@
+#pragma once
+
+#include <flecs/flecs.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "components.h"
+
+// Undo history of component values. Observers record each change as a delta (entity, component,
+// value before, value after), deltas to the same entity and component within a frame are merged,
+// and every frame with changes becomes one undo step. Undo and redo replay only those deltas.
+
+// Entries of a record, back to back:
+//   u64 entity, u8 track, u8 flags, u16 size, before[size] if HasBefore, after[size] if HasAfter.
+// Compressed records store after as a zero-run coded XOR against before when both exist, which
+// shrinks small edits such as a nudged marker to a few bytes.
+enum HistoryEntryFlags : uint8_t
+{
+    HISTORY_HAS_BEFORE = 1,
+    HISTORY_HAS_AFTER = 2,
+    HISTORY_XOR_AFTER = 4,
+};
+
+constexpr uint32_t HISTORY_CHUNK_BYTES = 64 * 1024;
+// The newest steps stay uncompressed so undoing them costs a copy and nothing more
+constexpr size_t HISTORY_HOT_RECORDS = 32;
+
+// One tracked component. The shadow holds every entity's current value, indexed by the low 32 bits
+// of the entity id, so observers know the value before a change without a lookup. flecs recycles
+// those bits, so each slot also remembers the full id it belongs to (0 when empty).
+struct HistoryTrack
+{
+    flecs::entity_t component;
+    uint16_t size;
+    std::vector<uint8_t> shadow;
+    std::vector<flecs::entity_t> owner;
+
+    uint8_t* slot(flecs::entity_t entity)
+    {
+        size_t index = static_cast<uint32_t>(entity);
+        if (index >= owner.size())
+        {
+            owner.resize(std::max<size_t>(index + 1, owner.size() * 2));
+            shadow.resize(owner.size() * size);
+        }
+        return shadow.data() + index * size;
+    }
+};
+
+struct HistoryChunk
+{
+    std::vector<uint8_t> bytes;
+    uint32_t used = 0;
+    uint32_t live = 0;
+};
+
+struct HistoryRecord
+{
+    uint32_t chunk;
+    uint32_t offset;
+    uint32_t bytes;
+    uint32_t entries;
+    bool compressed;
+};
+
+// A delta of the frame still being edited
+struct HistoryDelta
+{
+    flecs::entity_t entity;
+    uint8_t track;
+    bool hasBefore;
+    bool hasAfter;
+    std::vector<uint8_t> before;
+    std::vector<uint8_t> after;
+};
+
+// Undo and redo asked for by a system, carried out by stepEditor once the frame is over
+enum class HistoryRequest : uint8_t
+{
+    None,
+    Undo,
+    Redo,
+};
+
+struct EditHistory
+{
+    size_t memoryCap = 64 << 20;
+    std::vector<HistoryTrack> tracks;
+
+    std::vector<HistoryDelta> open;
+    std::unordered_map<uint64_t, size_t> openIndex;
+
+    std::deque<HistoryRecord> undo;
+    std::vector<HistoryRecord> redo;
+    std::deque<HistoryChunk> chunks;
+    // Index of chunks.front(), chunk numbers in records stay valid as old chunks are dropped
+    uint32_t firstChunk = 0;
+    size_t liveBytes = 0;
+    size_t allocatedBytes = 0;
+
+    // Entities deleted and recreated by undo get new ids, older records still name the old ones
+    std::unordered_map<flecs::entity_t, flecs::entity_t> remap;
+    // Changes made by undo and redo themselves, skipped by the observers. Keyed like openIndex.
+    std::unordered_set<uint64_t> applying;
+    HistoryRequest requested = HistoryRequest::None;
+};
+
+// The whole id, generation included, so a recycled id never merges with the entity it replaced.
+// The top 8 bits of an id are flecs role flags, which are always clear for entities.
+uint64_t historyKey(flecs::entity_t entity, uint8_t track)
+{
+    return (static_cast<uint64_t>(entity) << 8) | track;
+}
+
+flecs::entity_t resolveHistoryEntity(const EditHistory& history, flecs::entity_t entity)
+{
+    for (auto found = history.remap.find(entity); found != history.remap.end(); found = history.remap.find(entity))
+    {
+        entity = found->second;
+    }
+    return entity;
+}
+
+// Arena
+
+HistoryChunk& historyChunk(EditHistory& history, uint32_t chunk)
+{
+    return history.chunks[chunk - history.firstChunk];
+}
+
+uint8_t* allocateHistory(EditHistory& history, uint32_t bytes, HistoryRecord& record)
+{
+    if (history.chunks.empty() || history.chunks.back().bytes.size() - history.chunks.back().used < bytes)
+    {
+        history.chunks.emplace_back();
+        history.chunks.back().bytes.resize(std::max(bytes, HISTORY_CHUNK_BYTES));
+        history.allocatedBytes += history.chunks.back().bytes.size();
+    }
+    HistoryChunk& chunk = history.chunks.back();
+    record.chunk = history.firstChunk + static_cast<uint32_t>(history.chunks.size() - 1);
+    record.offset = chunk.used;
+    record.bytes = bytes;
+    chunk.used += bytes;
+    chunk.live += bytes;
+    history.liveBytes += bytes;
+    return chunk.bytes.data() + record.offset;
+}
+
+// Chunks are freed once nothing in them is live. Only the front ones are popped, emptied chunks in
+// the middle give their memory back and wait as empty placeholders.
+void releaseHistory(EditHistory& history, const HistoryRecord& record)
+{
+    HistoryChunk& chunk = historyChunk(history, record.chunk);
+    chunk.live -= record.bytes;
+    history.liveBytes -= record.bytes;
+    bool current = record.chunk == history.firstChunk + history.chunks.size() - 1;
+    if (chunk.live == 0 && !current)
+    {
+        history.allocatedBytes -= chunk.bytes.size();
+        std::vector<uint8_t>().swap(chunk.bytes);
+    }
+    while (history.chunks.size() > 1 && history.chunks.front().live == 0)
+    {
+        history.allocatedBytes -= history.chunks.front().bytes.size();
+        history.chunks.pop_front();
+        history.firstChunk++;
+    }
+}
+
+// Encoding
+
+template<typename T>
+void putHistory(std::vector<uint8_t>& out, T value)
+{
+    size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+template<typename T>
+T takeHistory(const uint8_t*& in)
+{
+    T value;
+    memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+// Runs of (u8 equal bytes, u8 literal count, literals) over after XOR before
+void encodeXor(std::vector<uint8_t>& out, const uint8_t* before, const uint8_t* after, uint16_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        uint8_t zeros = 0;
+        while (i < size && zeros < 255 && before[i] == after[i])
+        {
+            zeros++;
+            i++;
+        }
+        size_t literalStart = i;
+        uint8_t literals = 0;
+        while (i < size && literals < 255 && before[i] != after[i])
+        {
+            literals++;
+            i++;
+        }
+        out.push_back(zeros);
+        out.push_back(literals);
+        for (size_t j = literalStart; j < literalStart + literals; j++)
+        {
+            out.push_back(before[j] ^ after[j]);
+        }
+    }
+}
+
+void decodeXor(const uint8_t*& in, const uint8_t* before, uint8_t* after, uint16_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        uint8_t zeros = *in++;
+        uint8_t literals = *in++;
+        memcpy(after + i, before + i, zeros);
+        i += zeros;
+        for (uint8_t j = 0; j < literals; j++, i++)
+        {
+            after[i] = before[i] ^ *in++;
+        }
+    }
+}
+
+void encodeHistoryEntry(std::vector<uint8_t>& out, flecs::entity_t entity, uint8_t track, uint16_t size,
+    const uint8_t* before, const uint8_t* after, bool compress)
+{
+    uint8_t flags = (before ? HISTORY_HAS_BEFORE : 0) | (after ? HISTORY_HAS_AFTER : 0);
+    bool xorAfter = compress && before && after;
+    putHistory<uint64_t>(out, entity);
+    putHistory<uint8_t>(out, track);
+    putHistory<uint8_t>(out, flags | (xorAfter ? HISTORY_XOR_AFTER : 0));
+    putHistory<uint16_t>(out, size);
+    if (before)
+    {
+        out.insert(out.end(), before, before + size);
+    }
+    if (xorAfter)
+    {
+        encodeXor(out, before, after, size);
+    }
+    else if (after)
+    {
+        out.insert(out.end(), after, after + size);
+    }
+}
+
+// Calls visit(entity, track, before or null, after or null) for every entry of a record
+template<typename Visit>
+void visitHistoryRecord(EditHistory& history, const HistoryRecord& record, Visit visit)
+{
+    const uint8_t* in = historyChunk(history, record.chunk).bytes.data() + record.offset;
+    std::vector<uint8_t> after;
+    for (uint32_t i = 0; i < record.entries; i++)
+    {
+        auto entity = takeHistory<uint64_t>(in);
+        auto track = takeHistory<uint8_t>(in);
+        auto flags = takeHistory<uint8_t>(in);
+        auto size = takeHistory<uint16_t>(in);
+        const uint8_t* before = nullptr;
+        if (flags & HISTORY_HAS_BEFORE)
+        {
+            before = in;
+            in += size;
+        }
+        const uint8_t* afterValue = nullptr;
+        if (flags & HISTORY_XOR_AFTER)
+        {
+            after.resize(size);
+            decodeXor(in, before, after.data(), size);
+            afterValue = after.data();
+        }
+        else if (flags & HISTORY_HAS_AFTER)
+        {
+            afterValue = in;
+            in += size;
+        }
+        visit(entity, track, before, afterValue);
+    }
+}
+
+HistoryRecord storeHistoryRecord(EditHistory& history, const std::vector<uint8_t>& bytes, uint32_t entries, bool compressed)
+{
+    HistoryRecord record{};
+    uint8_t* out = allocateHistory(history, static_cast<uint32_t>(bytes.size()), record);
+    memcpy(out, bytes.data(), bytes.size());
+    record.entries = entries;
+    record.compressed = compressed;
+    return record;
+}
+
+// Rewrites a record that left the hot window in compressed form at the end of the arena
+void compressHistoryRecord(EditHistory& history, HistoryRecord& record)
+{
+    std::vector<uint8_t> bytes;
+    visitHistoryRecord(history, record, [&](flecs::entity_t entity, uint8_t track, const uint8_t* before, const uint8_t* after) {
+        encodeHistoryEntry(bytes, entity, track, history.tracks[track].size, before, after, true);
+    });
+    HistoryRecord compressed = storeHistoryRecord(history, bytes, record.entries, true);
+    releaseHistory(history, record);
+    record = compressed;
+}
+
+// Recording
+
+// The frame's delta for entity and track, opened with before (null if it had no value) when new
+HistoryDelta& openHistoryDelta(EditHistory& history, flecs::entity_t entity, uint8_t track, const uint8_t* before)
+{
+    uint64_t key = historyKey(entity, track);
+    auto found = history.openIndex.find(key);
+    if (found != history.openIndex.end())
+    {
+        return history.open[found->second];
+    }
+    HistoryDelta delta{entity, track, before != nullptr, false};
+    if (before)
+    {
+        delta.before.assign(before, before + history.tracks[track].size);
+    }
+    history.openIndex[key] = history.open.size();
+    history.open.push_back(std::move(delta));
+    return history.open.back();
+}
+
+void recordHistoryChange(EditHistory& history, flecs::entity_t entity, uint8_t track, const void* value)
+{
+    HistoryTrack& t = history.tracks[track];
+    uint8_t* shadow = t.slot(entity);
+    flecs::entity_t& owner = t.owner[static_cast<uint32_t>(entity)];
+    // The slot still belongs to an earlier generation whose removal wasn't seen. That entity is gone,
+    // so it's closed as removed before the recycled id opens a delta of its own.
+    if (owner != 0 && owner != entity && !history.applying.erase(historyKey(owner, track)))
+    {
+        HistoryDelta& closed = openHistoryDelta(history, owner, track, shadow);
+        closed.hasAfter = false;
+        closed.after.clear();
+    }
+    if (!history.applying.erase(historyKey(entity, track)))
+    {
+        HistoryDelta& delta = openHistoryDelta(history, entity, track, owner == entity ? shadow : nullptr);
+        delta.hasAfter = value != nullptr;
+        if (value)
+        {
+            delta.after.assign(static_cast<const uint8_t*>(value), static_cast<const uint8_t*>(value) + t.size);
+        }
+        else
+        {
+            delta.after.clear();
+        }
+    }
+    owner = value ? entity : 0;
+    if (value)
+    {
+        memcpy(shadow, value, t.size);
+    }
+}
+
+// Closes the frame's deltas into one undo step and applies the memory cap
+void commitHistory(EditHistory& history)
+{
+    if (history.open.empty())
+    {
+        return;
+    }
+    std::vector<uint8_t> bytes;
+    uint32_t entries = 0;
+    for (const auto& delta : history.open)
+    {
+        // Created and removed again within the frame, or set back to what it was
+        if (!delta.hasBefore && !delta.hasAfter)
+        {
+            continue;
+        }
+        if (delta.hasBefore && delta.hasAfter && delta.before == delta.after)
+        {
+            continue;
+        }
+        encodeHistoryEntry(bytes, delta.entity, delta.track, history.tracks[delta.track].size,
+            delta.hasBefore ? delta.before.data() : nullptr, delta.hasAfter ? delta.after.data() : nullptr, false);
+        entries++;
+    }
+    history.open.clear();
+    history.openIndex.clear();
+    if (entries == 0)
+    {
+        return;
+    }
+
+    for (const auto& record : history.redo)
+    {
+        releaseHistory(history, record);
+    }
+    history.redo.clear();
+    history.undo.push_back(storeHistoryRecord(history, bytes, entries, false));
+    if (history.undo.size() > HISTORY_HOT_RECORDS)
+    {
+        HistoryRecord& aged = history.undo[history.undo.size() - HISTORY_HOT_RECORDS - 1];
+        if (!aged.compressed)
+        {
+            compressHistoryRecord(history, aged);
+        }
+    }
+    while (history.undo.size() > 1 && history.allocatedBytes > history.memoryCap)
+    {
+        releaseHistory(history, history.undo.front());
+        history.undo.pop_front();
+    }
+}
+
+// Applying
+
+void applyHistoryValue(flecs::world& world, EditHistory& history, flecs::entity_t recorded, uint8_t track, const uint8_t* value)
+{
+    const HistoryTrack& t = history.tracks[track];
+    ecs_world_t* w = world.c_ptr();
+    flecs::entity_t entity = resolveHistoryEntity(history, recorded);
+    bool alive = ecs_is_alive(w, entity);
+    if (value)
+    {
+        if (!alive)
+        {
+            flecs::entity_t created = world.entity().id();
+            history.remap[entity] = created;
+            entity = created;
+        }
+        history.applying.insert(historyKey(entity, track));
+        ecs_set_id(w, entity, t.component, t.size, value);
+    }
+    else if (alive)
+    {
+        history.applying.insert(historyKey(entity, track));
+        // Entities that only existed for this component go away with it
+        if (ecs_vector_count(ecs_get_type(w, entity)) <= 1)
+        {
+            ecs_delete(w, entity);
+        }
+        else
+        {
+            ecs_remove_id(w, entity, t.component);
+        }
+    }
+}
+
+// Undo and redo must run outside ecs.progress. Inside a system their writes would be deferred and
+// reach the observers after the frame's commit, to be recorded as a new edit that clears redo.
+
+// Steps are undone as a whole, entries last to first
+bool undoHistory(flecs::world& world, EditHistory& history)
+{
+    commitHistory(history);
+    if (history.undo.empty())
+    {
+        return false;
+    }
+    HistoryRecord record = history.undo.back();
+    history.undo.pop_back();
+    // Before values are never compressed, so they can be applied straight from the arena
+    struct Entry
+    {
+        flecs::entity_t entity;
+        uint8_t track;
+        const uint8_t* before;
+    };
+    std::vector<Entry> entries;
+    visitHistoryRecord(history, record, [&](flecs::entity_t entity, uint8_t track, const uint8_t* before, const uint8_t* after) {
+        entries.push_back({entity, track, before});
+    });
+    for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry)
+    {
+        applyHistoryValue(world, history, entry->entity, entry->track, entry->before);
+    }
+    history.redo.push_back(record);
+    return true;
+}
+
+bool redoHistory(flecs::world& world, EditHistory& history)
+{
+    commitHistory(history);
+    if (history.redo.empty())
+    {
+        return false;
+    }
+    HistoryRecord record = history.redo.back();
+    history.redo.pop_back();
+    visitHistoryRecord(history, record, [&](flecs::entity_t entity, uint8_t track, const uint8_t* before, const uint8_t* after) {
+        applyHistoryValue(world, history, entity, track, after);
+    });
+    history.undo.push_back(record);
+    return true;
+}
+
+// Carries out the undo or redo a system requested during the frame. Outside progress the writes
+// reach the observers immediately, so applying is empty again once this returns.
+void applyHistoryRequest(flecs::world& world, EditHistory& history)
+{
+    HistoryRequest requested = history.requested;
+    history.requested = HistoryRequest::None;
+    if (requested == HistoryRequest::Undo)
+    {
+        undoHistory(world, history);
+    }
+    else if (requested == HistoryRequest::Redo)
+    {
+        redoHistory(world, history);
+    }
+    history.applying.clear();
+}
+
+// Starts recording T into the EditHistory of the "history" entity. Entities that already have it
+// are only taken into the shadow.
+template<typename T>
+void trackHistory(flecs::world& ecs, flecs::entity historyEntity)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "history stores components as bytes");
+    EditHistory* history = historyEntity.get_mut<EditHistory>();
+    uint8_t track = static_cast<uint8_t>(history->tracks.size());
+    history->tracks.push_back({ecs.component<T>().id(), static_cast<uint16_t>(sizeof(T))});
+
+    HistoryTrack& t = history->tracks.back();
+    auto existing = ecs.query<const T>();
+    existing.each([&](flecs::entity e, const T& value) {
+        memcpy(t.slot(e.id()), &value, sizeof(T));
+        t.owner[static_cast<uint32_t>(e.id())] = e.id();
+    });
+    existing.destruct();
+
+    ecs.observer<const T>()
+        .term<EditHistory>().subj("history")
+        .event(flecs::OnSet)
+        .iter([track](flecs::iter& it, const T* value) {
+            auto history = it.term<EditHistory>(2);
+            for (int i = 0; i < it.count(); i++)
+            {
+                recordHistoryChange(*history, it.entity(i).id(), track, &value[i]);
+            }
+        });
+
+    ecs.observer<const T>()
+        .term<EditHistory>().subj("history")
+        .event(flecs::OnRemove)
+        .iter([track](flecs::iter& it, const T* value) {
+            auto history = it.term<EditHistory>(2);
+            for (int i = 0; i < it.count(); i++)
+            {
+                recordHistoryChange(*history, it.entity(i).id(), track, nullptr);
+            }
+        });
+}
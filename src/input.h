@@ -0,0 +1,314 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "components.h"
+
+// Input log layout, little endian:
+//   header  "PINL" u32 version, u32 window width, u32 window height
+//   frame   f32 delta seconds, u16 event count, then the events
+//   event   u8 type followed by its payload (see writeInputFrame)
+constexpr char INPUT_LOG_MAGIC[4] = {'P', 'I', 'N', 'L'};
+constexpr uint32_t INPUT_LOG_VERSION = 1;
+
+struct InputLogWriter
+{
+    std::ofstream stream;
+    uint64_t frames = 0;
+};
+
+// Replays are short, the whole log is read up front so playback never touches the disk
+struct InputLogReader
+{
+    std::vector<char> data;
+    size_t offset = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t frames = 0;
+};
+
+template<typename T>
+void writeValue(std::ofstream& stream, T value)
+{
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(InputLogReader& reader, T& value)
+{
+    if (reader.offset + sizeof(T) > reader.data.size())
+    {
+        return false;
+    }
+    memcpy(&value, reader.data.data() + reader.offset, sizeof(T));
+    reader.offset += sizeof(T);
+    return true;
+}
+
+std::shared_ptr<InputLogWriter> openInputRecording(const std::string& path, uint32_t width, uint32_t height)
+{
+    auto writer = std::make_shared<InputLogWriter>();
+    writer->stream.open(path, std::ios::binary | std::ios::trunc);
+    if (!writer->stream.is_open())
+    {
+        spdlog::error("Failed to open input log {}", path);
+        return nullptr;
+    }
+    writer->stream.write(INPUT_LOG_MAGIC, sizeof(INPUT_LOG_MAGIC));
+    writeValue(writer->stream, INPUT_LOG_VERSION);
+    writeValue(writer->stream, width);
+    writeValue(writer->stream, height);
+    return writer;
+}
+
+std::shared_ptr<InputLogReader> openInputReplay(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        spdlog::error("Failed to open input log {}", path);
+        return nullptr;
+    }
+    auto reader = std::make_shared<InputLogReader>();
+    reader->data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    char magic[4];
+    uint32_t version = 0;
+    bool valid = readValue(*reader, magic) && memcmp(magic, INPUT_LOG_MAGIC, sizeof(magic)) == 0 &&
+        readValue(*reader, version) && version == INPUT_LOG_VERSION &&
+        readValue(*reader, reader->width) && readValue(*reader, reader->height);
+    if (!valid)
+    {
+        spdlog::error("{} is not a version {} input log", path, INPUT_LOG_VERSION);
+        return nullptr;
+    }
+    return reader;
+}
+
+void writeInputFrame(InputLogWriter& writer, float deltaSeconds, const std::vector<InputEvent>& events)
+{
+    std::ofstream& stream = writer.stream;
+    writeValue(stream, deltaSeconds);
+    writeValue(stream, static_cast<uint16_t>(std::min<size_t>(events.size(), UINT16_MAX)));
+    for (size_t i = 0; i < events.size() && i < UINT16_MAX; i++)
+    {
+        const InputEvent& event = events[i];
+        writeValue(stream, static_cast<uint8_t>(event.type));
+        switch (event.type)
+        {
+        case InputEventType::CursorPos:
+        case InputEventType::Scroll:
+            writeValue(stream, event.value.x);
+            writeValue(stream, event.value.y);
+            break;
+        case InputEventType::MouseButton:
+        case InputEventType::Key:
+            writeValue(stream, static_cast<int16_t>(event.code));
+            writeValue(stream, event.action);
+            writeValue(stream, event.mods);
+            break;
+        }
+    }
+    writer.frames++;
+}
+
+// Delta time of the next recorded frame without consuming it, zero once the log is exhausted
+float peekInputFrameDelta(const InputLogReader& reader)
+{
+    float deltaSeconds = 0.0f;
+    if (reader.offset + sizeof(float) <= reader.data.size())
+    {
+        memcpy(&deltaSeconds, reader.data.data() + reader.offset, sizeof(float));
+    }
+    return deltaSeconds;
+}
+
+bool readInputFrame(InputLogReader& reader, float& deltaSeconds, std::vector<InputEvent>& events)
+{
+    uint16_t count = 0;
+    if (!readValue(reader, deltaSeconds) || !readValue(reader, count))
+    {
+        return false;
+    }
+    for (uint16_t i = 0; i < count; i++)
+    {
+        InputEvent event{};
+        uint8_t type;
+        if (!readValue(reader, type))
+        {
+            return false;
+        }
+        event.type = static_cast<InputEventType>(type);
+        bool valid = true;
+        switch (event.type)
+        {
+        case InputEventType::CursorPos:
+        case InputEventType::Scroll:
+            valid = readValue(reader, event.value.x) && readValue(reader, event.value.y);
+            break;
+        case InputEventType::MouseButton:
+        case InputEventType::Key:
+        {
+            int16_t code;
+            valid = readValue(reader, code) && readValue(reader, event.action) && readValue(reader, event.mods);
+            event.code = code;
+            break;
+        }
+        default:
+            valid = false;
+        }
+        if (!valid)
+        {
+            spdlog::error("Corrupt input log at byte {}", reader.offset);
+            return false;
+        }
+        events.push_back(event);
+    }
+    reader.frames++;
+    return true;
+}
+
+// GLFW callbacks append to the queue the window user pointer refers to
+void queueInputEvent(GLFWwindow* window, const InputEvent& event)
+{
+    auto queue = static_cast<std::vector<InputEvent>*>(glfwGetWindowUserPointer(window));
+    if (queue)
+    {
+        queue->push_back(event);
+    }
+}
+
+void onCursorPos(GLFWwindow* window, double x, double y)
+{
+    InputEvent event{};
+    event.type = InputEventType::CursorPos;
+    event.value = {static_cast<float>(x), static_cast<float>(y)};
+    queueInputEvent(window, event);
+}
+
+void onMouseButton(GLFWwindow* window, int button, int action, int mods)
+{
+    InputEvent event{};
+    event.type = InputEventType::MouseButton;
+    event.code = button;
+    event.action = static_cast<uint8_t>(action);
+    event.mods = static_cast<uint8_t>(mods);
+    queueInputEvent(window, event);
+}
+
+void onKey(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    InputEvent event{};
+    event.type = InputEventType::Key;
+    event.code = key;
+    event.action = static_cast<uint8_t>(action);
+    event.mods = static_cast<uint8_t>(mods);
+    queueInputEvent(window, event);
+}
+
+void onScroll(GLFWwindow* window, double x, double y)
+{
+    InputEvent event{};
+    event.type = InputEventType::Scroll;
+    event.value = {static_cast<float>(x), static_cast<float>(y)};
+    queueInputEvent(window, event);
+}
+
+// Folds one frame of events into the input state the systems read
+void applyInputEvents(InputState& input, const std::vector<InputEvent>& events)
+{
+    input.pressed = 0;
+    input.released = 0;
+    input.scroll = {0.0f, 0.0f};
+    input.keys.clear();
+    for (const auto& event : events)
+    {
+        switch (event.type)
+        {
+        case InputEventType::CursorPos:
+            input.cursor = event.value;
+            break;
+        case InputEventType::MouseButton:
+            if (event.code >= 0 && event.code < 32)
+            {
+                uint32_t bit = 1u << event.code;
+                if (event.action == GLFW_PRESS)
+                {
+                    input.buttons |= bit;
+                    input.pressed |= bit;
+                }
+                else if (event.action == GLFW_RELEASE)
+                {
+                    input.buttons &= ~bit;
+                    input.released |= bit;
+                }
+            }
+            break;
+        case InputEventType::Scroll:
+            input.scroll += event.value;
+            break;
+        case InputEventType::Key:
+            if (event.action != GLFW_RELEASE)
+            {
+                input.keys.push_back(event);
+            }
+            break;
+        }
+    }
+}
+
+bool keyPressed(const InputState& input, int key, int mods)
+{
+    for (const auto& event : input.keys)
+    {
+        if (event.code == key && (event.mods & mods) == mods)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// captureStallMilliseconds is the lossless capture wait already taken out of the frame times
+void reportFrameTimes(const std::vector<float>& frameMilliseconds, const std::string& path, double captureStallMilliseconds)
+{
+    if (frameMilliseconds.empty())
+    {
+        return;
+    }
+    std::vector<float> sorted = frameMilliseconds;
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](float p) { return sorted[static_cast<size_t>(p * (sorted.size() - 1))]; };
+    double total = 0.0;
+    for (float ms : sorted)
+    {
+        total += ms;
+    }
+    spdlog::info("Replayed {} frames: mean {:.3f} ms, p50 {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms",
+        sorted.size(), total / sorted.size(), percentile(0.5f), percentile(0.95f), percentile(0.99f), sorted.back());
+    if (captureStallMilliseconds > 0.0)
+    {
+        spdlog::info("Excluded {:.3f} ms spent waiting for frame capture", captureStallMilliseconds);
+    }
+
+    if (path.empty())
+    {
+        return;
+    }
+    std::ofstream report(path, std::ios::trunc);
+    if (!report.is_open())
+    {
+        spdlog::error("Failed to open frame time report {}", path);
+        return;
+    }
+    report << "frame,milliseconds\n";
+    for (size_t i = 0; i < frameMilliseconds.size(); i++)
+    {
+        report << i << ',' << frameMilliseconds[i] << '\n';
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "components.h"
+#include "private/chromium/GrDeferredDisplayListRecorder.h"
+
+// Fork-join pool that records SkiaLayers into deferred display lists. The render thread hands out
+// one frame's layers, takes part in recording them and returns once all are done, so layers only
+// ever read the world while the systems that write it are not running.
+struct SkiaRecorderPool
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping = false;
+    // Set while a frame is being recorded. Workers that wake after it finished find nothing to do.
+    bool active = false;
+    // Workers currently recording outside the lock, the frame only ends once they are all back
+    uint32_t busy = 0;
+
+    // The frame being recorded
+    std::vector<SkiaLayer*> layers;
+    GrSurfaceCharacterization characterization;
+    float canvasScale = 1.0f;
+    SkSize logicalSize;
+    std::atomic<size_t> next{0};
+    size_t remaining = 0;
+};
+
+void recordSkiaLayer(SkiaRecorderPool& pool, SkiaLayer& layer)
+{
+    GrDeferredDisplayListRecorder recorder(pool.characterization);
+    SkCanvas* canvas = recorder.getCanvas();
+    if (!canvas)
+    {
+        spdlog::error("Failed to create a Skia display list recorder");
+        layer.displayList.reset();
+        return;
+    }
+    canvas->scale(pool.canvasScale, pool.canvasScale);
+    layer.record(canvas, pool.logicalSize);
+    layer.displayList = recorder.detach();
+}
+
+// Records layers until none are left, returns how many this thread took
+size_t recordPendingLayers(SkiaRecorderPool& pool)
+{
+    size_t recorded = 0;
+    for (size_t i = pool.next++; i < pool.layers.size(); i = pool.next++)
+    {
+        recordSkiaLayer(pool, *pool.layers[i]);
+        recorded++;
+    }
+    return recorded;
+}
+
+void runSkiaRecorder(SkiaRecorderPool* pool)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    while (true)
+    {
+        pool->wake.wait(lock, [&] { return pool->stopping || (pool->active && pool->next < pool->layers.size()); });
+        if (pool->stopping)
+        {
+            break;
+        }
+        pool->busy++;
+        lock.unlock();
+        size_t recorded = recordPendingLayers(*pool);
+        lock.lock();
+        pool->busy--;
+        pool->remaining -= recorded;
+        pool->done.notify_one();
+    }
+}
+
+std::shared_ptr<SkiaRecorderPool> startSkiaRecorders(uint32_t threadCount)
+{
+    auto pool = std::make_shared<SkiaRecorderPool>();
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        pool->threads.emplace_back(runSkiaRecorder, pool.get());
+    }
+    return pool;
+}
+
+// Records every layer on the pool and the calling thread, layers keep their display lists
+void recordSkiaLayers(SkiaRecorderPool& pool, std::vector<SkiaLayer*>& layers,
+    const GrSurfaceCharacterization& characterization, float canvasScale, SkSize logicalSize)
+{
+    if (layers.empty())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.layers.swap(layers);
+        pool.characterization = characterization;
+        pool.canvasScale = canvasScale;
+        pool.logicalSize = logicalSize;
+        pool.next = 0;
+        pool.remaining = pool.layers.size();
+        pool.active = true;
+    }
+    // A single layer isn't worth waking anyone for
+    if (pool.layers.size() > 1)
+    {
+        pool.wake.notify_all();
+    }
+
+    size_t recorded = recordPendingLayers(pool);
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.remaining -= recorded;
+    pool.done.wait(lock, [&] { return pool.remaining == 0 && pool.busy == 0; });
+    pool.active = false;
+    pool.layers.swap(layers);
+}
+
+void stopSkiaRecorders(SkiaRecorderPool& pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.stopping = true;
+    }
+    pool.wake.notify_all();
+    for (auto& thread : pool.threads)
+    {
+        thread.join();
+    }
+    pool.threads.clear();
+}
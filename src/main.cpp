@@ -9,105 +9,81 @@
 #include <flecs/flecs.h>
 
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
 
-#include "systems.h"
-#include "components.h"
+#include "editor.h"
 
-int main()
+int main(int argc, char** argv)
 {
-    flecs::world ecs;
-    // ecs.set_threads(FLECS_THREAD_COUNT);
-
-    ecs.trigger<PlatformFramework>().event(flecs::OnAdd).each(SetupFramework);
-    ecs.trigger<Window>().event(flecs::OnAdd).each(CreateWindow);
-
-    ecs.system<PlatformFramework>().kind(flecs::PreUpdate).iter(PollEvents);
-    ecs.system<Window>().iter(CloseWindow);
-
-    auto platform = ecs.entity("core")
-        .add<PlatformFramework>()
-        .add<RenderDevice>()
-        .add<SkiaGPU>();
-
-    auto window = ecs.entity("window").add<Window>();
-
-    ecs.observer<Window>()
-        .term<PlatformFramework>().subj("core")
-        .term<RenderDevice>().subj("core")
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateWindowSurface);
-
-    ecs.observer<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(SelectPrimaryRenderDevice);
-
-    ecs.observer<PlatformFramework, RenderDevice>().event(flecs::OnAdd).yield_existing().each(SpecifyLogicalDevice);
-    
-    ecs.observer<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateSwapChain);
-
-    ecs.observer<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateRenderPass);
-
-    ecs.observer<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateGraphicsPipeline);
-
-    ecs.observer<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateFramebuffers);
-
-    ecs.observer<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateCommandPool);
-
-    ecs.observer<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateSyncObjects);
-
-    ecs.observer<PlatformFramework, RenderDevice, SkiaGPU>()
-        .term<Window>().subj("window")
-        .event(flecs::OnAdd)
-        .yield_existing()
-        .iter(CreateSkiaSurface);
-
-    ecs.observer<Window>()
-        .term<PlatformFramework>().subj("core")
-        .term<RenderDevice>().subj("core")
-        .event(flecs::OnRemove)
-        .iter(DestroyWindowSurface);
-
-    ecs.observer<PlatformFramework, RenderDevice>().event(flecs::OnRemove).each(ShutdownFramework);
-    ecs.trigger<Window>().event(flecs::OnRemove).each(DestroyWindow);
+    // --capture <file.y4m|file.png|file.raw> records every presented frame, --capture-fps sets the Y4M rate.
+    // --record <log> saves input, --replay <log> plays it back headless with a frame time report
+    // (--report <csv>) and optional per-frame image hashes (--hash <file>).
+    // --project <file> loads a snapshot at startup, ctrl+S and quitting save back to it.
+    EditorOptions options;
+    FrameCapture& capture = options.capture;
+    InputSession& session = options.session;
+    std::string replayPath;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--capture" && i + 1 < argc)
+        {
+            capture.path = argv[++i];
+            capture.format = captureFormatFromPath(capture.path);
+        }
+        else if (arg == "--capture-fps" && i + 1 < argc)
+        {
+            capture.framesPerSecond = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            options.recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if (arg == "--report" && i + 1 < argc)
+        {
+            session.reportPath = argv[++i];
+        }
+        else if (arg == "--project" && i + 1 < argc)
+        {
+            options.projectPath = argv[++i];
+        }
+        else if (arg == "--hash" && i + 1 < argc)
+        {
+            capture.path = argv[++i];
+            capture.format = CaptureFormat::Hash;
+            capture.lossless = true;
+        }
+        else
+        {
+            spdlog::warn("Ignoring unknown argument {}", arg);
+        }
+    }
 
-    ecs.system<SkiaGPU>()
-        .iter(RenderSkiaTest);
+    if (!replayPath.empty())
+    {
+        session.reader = openInputReplay(replayPath);
+        if (!session.reader)
+        {
+            return 1;
+        }
+        session.mode = InputMode::Replay;
+    }
 
-    ecs.system<PlatformFramework, RenderDevice>()
-        .term<Window>().subj("window").read_write()
-        .iter(RenderFrame);
-        
-    while (!ecs.should_quit())
+    flecs::world ecs;
+    if (!buildEditor(ecs, options))
+    {
+        return 1;
+    }
+    while (stepEditor(ecs, options))
     {
-        ecs.progress();
     }
+    finishEditor(ecs);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,530 @@
+#pragma once
+
+#include <flecs/flecs.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "components.h"
+#include "spatial.h"
+
+// Snapshot layout, little endian, every section starts 8 byte aligned:
+//   header   "PSNP" u32 version, u64 reserved
+//   section  SnapshotSection followed by `bytes` of payload
+// Payloads are fixed-size structure-of-arrays blocks, so a mapped file is used in place.
+// Sections are only ever appended: the latest one of each kind wins, except marker appends,
+// which add to the latest full marker section before them.
+constexpr char SNAPSHOT_MAGIC[4] = {'P', 'S', 'N', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+// Version 1 spirals end before LogSpiral::turnRate, they load with the editor's default
+constexpr uint32_t SNAPSHOT_OLDEST_VERSION = 1;
+constexpr size_t SPIRAL_V1_BYTES = offsetof(LogSpiral, turnRate);
+
+enum class SnapshotKind : uint32_t
+{
+    // count markers, aux cells. f32 cellSize, pad, f32 x[count], f32 y[count] in cell order,
+    // u64 cellKey[aux], u32 cellStart[aux + 1]
+    Markers = 1,
+    // count markers. f32 x[count], f32 y[count]
+    MarkerAppend = 2,
+    // One LogSpiral
+    Spiral = 3,
+    // One LoopState
+    Loop = 4,
+    // count polylines, aux vertices. u32 offsets[count + 1], LineVertex vertices[aux]
+    Polylines = 5,
+};
+
+struct SnapshotHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t reserved;
+};
+
+struct SnapshotSection
+{
+    uint32_t kind;
+    uint32_t version;
+    uint64_t count;
+    uint64_t aux;
+    uint64_t bytes;
+};
+
+size_t snapshotAlign(size_t size)
+{
+    return (size + 7) & ~size_t(7);
+}
+
+// Accumulates one section payload, padding every array to the section alignment
+struct SnapshotPayload
+{
+    std::vector<char> bytes;
+
+    void put(const void* data, size_t size)
+    {
+        size_t offset = bytes.size();
+        bytes.resize(offset + snapshotAlign(size));
+        memcpy(bytes.data() + offset, data, size);
+    }
+};
+
+void writeSnapshotSection(std::ofstream& stream, SnapshotKind kind, uint64_t count, uint64_t aux, const SnapshotPayload& payload)
+{
+    SnapshotSection section{static_cast<uint32_t>(kind), SNAPSHOT_VERSION, count, aux, payload.bytes.size()};
+    stream.write(reinterpret_cast<const char*>(&section), sizeof(section));
+    stream.write(payload.bytes.data(), payload.bytes.size());
+}
+
+// Markers are written straight from the spatial index, which already groups them by cell.
+// Loading can then rebuild the index from the cell table without hashing every marker.
+uint64_t writeMarkerSection(std::ofstream& stream, const MarkerIndex& index)
+{
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<uint64_t> cellKeys;
+    std::vector<uint32_t> cellStarts;
+    for (const auto& [key, entries] : index.cells)
+    {
+        if (entries.empty())
+        {
+            continue;
+        }
+        cellKeys.push_back(key);
+        cellStarts.push_back(static_cast<uint32_t>(xs.size()));
+        for (const auto& entry : entries)
+        {
+            xs.push_back(entry.position.x);
+            ys.push_back(entry.position.y);
+        }
+    }
+    cellStarts.push_back(static_cast<uint32_t>(xs.size()));
+
+    SnapshotPayload payload;
+    payload.put(&index.cellSize, sizeof(float));
+    payload.put(xs.data(), xs.size() * sizeof(float));
+    payload.put(ys.data(), ys.size() * sizeof(float));
+    payload.put(cellKeys.data(), cellKeys.size() * sizeof(uint64_t));
+    payload.put(cellStarts.data(), cellStarts.size() * sizeof(uint32_t));
+    writeSnapshotSection(stream, SnapshotKind::Markers, xs.size(), cellKeys.size(), payload);
+    return xs.size();
+}
+
+void writeMarkerAppendSection(std::ofstream& stream, flecs::entity loop, const std::unordered_set<flecs::entity_t>& markers)
+{
+    std::vector<float> xs;
+    std::vector<float> ys;
+    for (auto id : markers)
+    {
+        const Marker* marker = flecs::entity(loop.world(), id).get<Marker>();
+        if (marker)
+        {
+            xs.push_back(marker->position.x);
+            ys.push_back(marker->position.y);
+        }
+    }
+    SnapshotPayload payload;
+    payload.put(xs.data(), xs.size() * sizeof(float));
+    payload.put(ys.data(), ys.size() * sizeof(float));
+    writeSnapshotSection(stream, SnapshotKind::MarkerAppend, xs.size(), 0, payload);
+}
+
+void writePolylineSection(std::ofstream& stream, flecs::query<const Polyline>& polylines)
+{
+    std::vector<uint32_t> offsets = {0};
+    std::vector<LineVertex> vertices;
+    polylines.each([&](flecs::entity e, const Polyline& polyline) {
+        vertices.insert(vertices.end(), polyline.vertices.begin(), polyline.vertices.end());
+        offsets.push_back(static_cast<uint32_t>(vertices.size()));
+    });
+    SnapshotPayload payload;
+    payload.put(offsets.data(), offsets.size() * sizeof(uint32_t));
+    payload.put(vertices.data(), vertices.size() * sizeof(LineVertex));
+    writeSnapshotSection(stream, SnapshotKind::Polylines, offsets.size() - 1, vertices.size(), payload);
+}
+
+// Appends what changed since the last save. The whole file is rewritten instead when it doesn't
+// exist yet or superseded sections make up most of it.
+void saveSnapshot(flecs::entity loop, ProjectSnapshot& snapshot)
+{
+    auto start = std::chrono::steady_clock::now();
+    const MarkerIndex* index = loop.get<MarkerIndex>();
+    const LogSpiral* spiral = loop.get<LogSpiral>();
+    const LoopState* state = loop.get<LoopState>();
+    uint64_t markerCount = 0;
+    for (const auto& ref : index->cellOf)
+    {
+        markerCount += ref.indexed;
+    }
+    uint64_t liveBytes = sizeof(SnapshotHeader) + 4 * sizeof(SnapshotSection) + markerCount * 2 * sizeof(float) +
+        index->cells.size() * (sizeof(uint64_t) + sizeof(uint32_t)) + sizeof(LogSpiral) + sizeof(LoopState);
+    bool compact = snapshot.fileBytes == 0 || snapshot.fileBytes > 2 * liveBytes + (1 << 20);
+
+    std::string path = compact ? snapshot.path + ".tmp" : snapshot.path;
+    std::ofstream stream(path, std::ios::binary | (compact ? std::ios::trunc : std::ios::app));
+    if (!stream.is_open())
+    {
+        spdlog::error("Failed to open snapshot {}", path);
+        return;
+    }
+    if (compact)
+    {
+        SnapshotHeader header{};
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    // Appends are cheap to write but slow to load, so once they grow past a quarter of the
+    // full section everything is written in cell order again
+    bool fullMarkers = compact || snapshot.rewriteMarkers ||
+        snapshot.markersAppended + snapshot.addedMarkers.size() > snapshot.markersInFullSection / 4;
+    if (fullMarkers)
+    {
+        snapshot.markersInFullSection = writeMarkerSection(stream, *index);
+        snapshot.markersAppended = 0;
+    }
+    else if (!snapshot.addedMarkers.empty())
+    {
+        writeMarkerAppendSection(stream, loop, snapshot.addedMarkers);
+        snapshot.markersAppended += snapshot.addedMarkers.size();
+    }
+    snapshot.addedMarkers.clear();
+    snapshot.rewriteMarkers = false;
+
+    if (compact || !snapshot.loopSaved || memcmp(&snapshot.savedSpiral, spiral, sizeof(LogSpiral)) != 0)
+    {
+        SnapshotPayload payload;
+        payload.put(spiral, sizeof(LogSpiral));
+        writeSnapshotSection(stream, SnapshotKind::Spiral, 1, 0, payload);
+        snapshot.savedSpiral = *spiral;
+    }
+    if (compact || !snapshot.loopSaved || memcmp(&snapshot.savedLoop, state, sizeof(LoopState)) != 0)
+    {
+        SnapshotPayload payload;
+        payload.put(state, sizeof(LoopState));
+        writeSnapshotSection(stream, SnapshotKind::Loop, 1, 0, payload);
+        snapshot.savedLoop = *state;
+    }
+    snapshot.loopSaved = true;
+    if (compact || snapshot.polylines.changed())
+    {
+        writePolylineSection(stream, snapshot.polylines);
+    }
+
+    stream.close();
+    if (compact && std::rename(path.c_str(), snapshot.path.c_str()) != 0)
+    {
+        spdlog::error("Failed to replace snapshot {}", snapshot.path);
+        return;
+    }
+    struct stat info;
+    snapshot.fileBytes = stat(snapshot.path.c_str(), &info) == 0 ? info.st_size : 0;
+    spdlog::info("Saved {} ({} markers, {}) in {:.1f} ms", snapshot.path, markerCount, compact ? "compacted" : "appended",
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Files markers created in bulk straight from the snapshot's cell table, no per-marker hashing
+void indexLoadedMarkers(MarkerIndex& index, const ecs_entity_t* entities, const Marker* markers,
+    uint64_t cellCount, const uint64_t* cellKeys, const uint32_t* cellStarts)
+{
+    flecs::entity_t highest = 0;
+    for (uint64_t i = 0; i < cellStarts[cellCount]; i++)
+    {
+        highest = std::max(highest, static_cast<flecs::entity_t>(static_cast<uint32_t>(entities[i])));
+    }
+    if (highest >= index.cellOf.size())
+    {
+        index.cellOf.resize(highest + 1);
+    }
+    index.cells.reserve(index.cells.size() + cellCount);
+    for (uint64_t c = 0; c < cellCount; c++)
+    {
+        auto& cell = index.cells[cellKeys[c]];
+        for (uint32_t i = cellStarts[c]; i < cellStarts[c + 1]; i++)
+        {
+            cell.push_back({markers[i].position, entities[i]});
+            index.cellOf[static_cast<uint32_t>(entities[i])] = {cellKeys[c], true};
+        }
+    }
+}
+
+// Whether a section's counts fit its payload, so a damaged count can't send reads past the mapping.
+// The cell and polyline offset tables are checked too, since they index the arrays after them.
+bool validSnapshotSection(const SnapshotSection* section)
+{
+    const char* payload = reinterpret_cast<const char*>(section + 1);
+    uint64_t bytes = section->bytes;
+    // Counts are checked against the payload before anything is multiplied by them
+    auto arrayBytes = [&](uint64_t count, size_t elementSize) -> uint64_t {
+        return count <= bytes / elementSize ? snapshotAlign(count * elementSize) : UINT64_MAX;
+    };
+    auto fits = [&](std::initializer_list<uint64_t> arrays) {
+        uint64_t total = 0;
+        for (uint64_t array : arrays)
+        {
+            if (array > bytes - total)
+            {
+                return false;
+            }
+            total += array;
+        }
+        return true;
+    };
+    switch (static_cast<SnapshotKind>(section->kind))
+    {
+    case SnapshotKind::Markers:
+    {
+        uint64_t count = section->count;
+        uint64_t cells = section->aux;
+        if (cells >= bytes / sizeof(uint64_t) ||
+            !fits({snapshotAlign(sizeof(float)), arrayBytes(count, sizeof(float)), arrayBytes(count, sizeof(float)),
+                arrayBytes(cells, sizeof(uint64_t)), arrayBytes(cells + 1, sizeof(uint32_t))}))
+        {
+            return false;
+        }
+        const char* table = payload + snapshotAlign(sizeof(float)) + 2 * snapshotAlign(count * sizeof(float));
+        const uint32_t* cellStarts = reinterpret_cast<const uint32_t*>(table + cells * sizeof(uint64_t));
+        for (uint64_t c = 0; c < cells; c++)
+        {
+            if (cellStarts[c] > cellStarts[c + 1])
+            {
+                return false;
+            }
+        }
+        return cellStarts[0] == 0 && cellStarts[cells] == count;
+    }
+    case SnapshotKind::MarkerAppend:
+        return fits({arrayBytes(section->count, sizeof(float)), arrayBytes(section->count, sizeof(float))});
+    case SnapshotKind::Spiral:
+        return bytes >= (section->version < 2 ? SPIRAL_V1_BYTES : sizeof(LogSpiral));
+    case SnapshotKind::Loop:
+        return bytes >= sizeof(LoopState);
+    case SnapshotKind::Polylines:
+    {
+        uint64_t count = section->count;
+        uint64_t vertices = section->aux;
+        if (count >= bytes / sizeof(uint32_t) ||
+            !fits({arrayBytes(count + 1, sizeof(uint32_t)), arrayBytes(vertices, sizeof(LineVertex))}))
+        {
+            return false;
+        }
+        const uint32_t* offsets = reinterpret_cast<const uint32_t*>(payload);
+        for (uint64_t i = 0; i < count; i++)
+        {
+            if (offsets[i] > offsets[i + 1])
+            {
+                return false;
+            }
+        }
+        return offsets[count] <= vertices;
+    }
+    }
+    // Unknown kinds are skipped
+    return true;
+}
+
+// Maps the snapshot and applies the latest state it holds. Must run before the Marker observers
+// exist, since the markers are created in bulk and indexed here instead.
+// Returns false when a file exists but can't be read as a snapshot; saving would then replace it,
+// so the caller must not keep the path. A missing or empty file is a new project.
+bool loadSnapshot(flecs::world& world, flecs::entity loop, ProjectSnapshot& snapshot)
+{
+    auto start = std::chrono::steady_clock::now();
+    int fd = open(snapshot.path.c_str(), O_RDONLY);
+    if (fd < 0 && errno == ENOENT)
+    {
+        spdlog::info("No snapshot at {}, starting a new project", snapshot.path);
+        return true;
+    }
+    if (fd < 0)
+    {
+        spdlog::error("Failed to open snapshot {}: {}", snapshot.path, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size == 0)
+    {
+        close(fd);
+        spdlog::info("Snapshot {} is empty, starting a new project", snapshot.path);
+        return true;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        spdlog::error("Failed to map snapshot {}", snapshot.path);
+        return false;
+    }
+    const char* data = static_cast<const char*>(mapping);
+
+    SnapshotHeader header;
+    memcpy(&header, data, std::min(size, sizeof(header)));
+    if (size < sizeof(header) || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version < SNAPSHOT_OLDEST_VERSION || header.version > SNAPSHOT_VERSION)
+    {
+        spdlog::error("{} is not a version {} to {} snapshot", snapshot.path, SNAPSHOT_OLDEST_VERSION, SNAPSHOT_VERSION);
+        munmap(mapping, size);
+        return false;
+    }
+
+    // Only section headers are visited, payloads are used where they lie
+    const SnapshotSection* markers = nullptr;
+    std::vector<const SnapshotSection*> appends;
+    const SnapshotSection* spiral = nullptr;
+    const SnapshotSection* state = nullptr;
+    const SnapshotSection* polylines = nullptr;
+    // A torn or damaged tail must not stay in the file, or the next append would follow it and
+    // make it parse as a whole section. Any damage makes the next save rewrite the file, and so
+    // does an older version, so appends never mix layouts.
+    bool damaged = header.version != SNAPSHOT_VERSION;
+    size_t offset = sizeof(header);
+    while (offset < size)
+    {
+        auto section = reinterpret_cast<const SnapshotSection*>(data + offset);
+        if (size - offset < sizeof(SnapshotSection) || section->bytes > size - offset - sizeof(SnapshotSection))
+        {
+            spdlog::warn("Snapshot {} ends in a partial section, ignoring it", snapshot.path);
+            damaged = true;
+            break;
+        }
+        if (section->bytes % 8 != 0)
+        {
+            spdlog::warn("Snapshot {} has a damaged section at byte {}, ignoring the rest", snapshot.path, offset);
+            damaged = true;
+            break;
+        }
+        offset += sizeof(SnapshotSection) + section->bytes;
+        if (!validSnapshotSection(section))
+        {
+            spdlog::warn("Snapshot {} has a section whose counts don't fit it at byte {}, skipping it",
+                snapshot.path, offset - sizeof(SnapshotSection) - section->bytes);
+            damaged = true;
+            // Appends after a lost marker section belong to it, not to the one before
+            if (static_cast<SnapshotKind>(section->kind) == SnapshotKind::Markers)
+            {
+                markers = nullptr;
+                appends.clear();
+            }
+            continue;
+        }
+        switch (static_cast<SnapshotKind>(section->kind))
+        {
+        case SnapshotKind::Markers:
+            markers = section;
+            appends.clear();
+            break;
+        case SnapshotKind::MarkerAppend:
+            appends.push_back(section);
+            break;
+        case SnapshotKind::Spiral:
+            spiral = section;
+            break;
+        case SnapshotKind::Loop:
+            state = section;
+            break;
+        case SnapshotKind::Polylines:
+            polylines = section;
+            break;
+        }
+    }
+    auto payload = [](const SnapshotSection* section) { return reinterpret_cast<const char*>(section + 1); };
+
+    if (spiral)
+    {
+        LogSpiral loaded = *loop.get<LogSpiral>();
+        memcpy(&loaded, payload(spiral), spiral->version < 2 ? SPIRAL_V1_BYTES : sizeof(LogSpiral));
+        loop.set<LogSpiral>(loaded);
+        snapshot.savedSpiral = loaded;
+    }
+    if (state)
+    {
+        loop.set<LoopState>(*reinterpret_cast<const LoopState*>(payload(state)));
+        snapshot.savedLoop = *loop.get<LoopState>();
+    }
+    snapshot.loopSaved = spiral && state;
+
+    uint64_t markerCount = markers ? markers->count : 0;
+    for (auto append : appends)
+    {
+        markerCount += append->count;
+    }
+    MarkerIndex* index = loop.get_mut<MarkerIndex>();
+    if (markerCount > 0)
+    {
+        // Interleave the SoA positions into component order and create every marker in one call
+        std::vector<Marker> values(markerCount);
+        uint64_t filled = 0;
+        const uint64_t* cellKeys = nullptr;
+        const uint32_t* cellStarts = nullptr;
+        float cellSize = 0.0f;
+        if (markers)
+        {
+            const char* p = payload(markers);
+            cellSize = *reinterpret_cast<const float*>(p);
+            const float* xs = reinterpret_cast<const float*>(p + snapshotAlign(sizeof(float)));
+            const float* ys = reinterpret_cast<const float*>(reinterpret_cast<const char*>(xs) + snapshotAlign(markers->count * sizeof(float)));
+            cellKeys = reinterpret_cast<const uint64_t*>(reinterpret_cast<const char*>(ys) + snapshotAlign(markers->count * sizeof(float)));
+            cellStarts = reinterpret_cast<const uint32_t*>(cellKeys + markers->aux);
+            for (uint64_t i = 0; i < markers->count; i++)
+            {
+                values[filled++].position = {xs[i], ys[i]};
+            }
+        }
+        for (auto append : appends)
+        {
+            const float* xs = reinterpret_cast<const float*>(payload(append));
+            const float* ys = reinterpret_cast<const float*>(payload(append) + snapshotAlign(append->count * sizeof(float)));
+            for (uint64_t i = 0; i < append->count; i++)
+            {
+                values[filled++].position = {xs[i], ys[i]};
+            }
+        }
+
+        ecs_id_t markerId = world.component<Marker>().id();
+        ecs_ids_t ids = {&markerId, 1};
+        void* columns[] = {values.data()};
+        const ecs_entity_t* entities = ecs_bulk_new_w_data(world.c_ptr(), static_cast<int32_t>(markerCount), &ids, columns);
+
+        uint64_t indexed = 0;
+        if (markers && cellSize == index->cellSize)
+        {
+            indexLoadedMarkers(*index, entities, values.data(), markers->aux, cellKeys, cellStarts);
+            indexed = markers->count;
+        }
+        for (uint64_t i = indexed; i < markerCount; i++)
+        {
+            insertMarker(*index, entities[i], values[i].position);
+        }
+    }
+    snapshot.markersInFullSection = markers ? markers->count : 0;
+    snapshot.markersAppended = markerCount - snapshot.markersInFullSection;
+
+    if (polylines)
+    {
+        const uint32_t* offsets = reinterpret_cast<const uint32_t*>(payload(polylines));
+        const LineVertex* vertices = reinterpret_cast<const LineVertex*>(payload(polylines) + snapshotAlign((polylines->count + 1) * sizeof(uint32_t)));
+        for (uint64_t i = 0; i < polylines->count; i++)
+        {
+            world.entity().set<Polyline>({std::vector<LineVertex>(vertices + offsets[i], vertices + offsets[i + 1])});
+        }
+    }
+
+    munmap(mapping, size);
+    snapshot.fileBytes = damaged ? 0 : size;
+    spdlog::info("Loaded {} ({} markers) in {:.1f} ms", snapshot.path, markerCount,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
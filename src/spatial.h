@@ -0,0 +1,224 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/geometric.hpp>
+#include <cmath>
+#include <algorithm>
+#include "components.h"
+
+constexpr float TWO_PI = 6.28318530717958647692f;
+
+glm::vec2 rotate(glm::vec2 p, float angle)
+{
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    return {c * p.x - s * p.y, s * p.x + c * p.y};
+}
+
+// Rotation of the spiral as drawn at a point in loop time
+float spiralAngle(const LogSpiral& spiral, float loopTime)
+{
+    return spiral.rotation + loopTime * spiral.turnRate;
+}
+
+// The spiral as drawn at loopTime, for the queries below
+LogSpiral posedSpiral(const LogSpiral& spiral, float loopTime)
+{
+    LogSpiral posed = spiral;
+    posed.rotation = spiralAngle(spiral, loopTime);
+    return posed;
+}
+
+glm::vec2 spiralPoint(const LogSpiral& spiral, uint32_t index)
+{
+    float phi = spiral.phiStart + index * spiral.phiStep;
+    float r = spiral.a * std::exp(spiral.k * phi);
+    return spiral.center + rotate({r * std::cos(phi), r * std::sin(phi)}, spiral.rotation);
+}
+
+uint32_t spiralIndexAtAngle(const LogSpiral& spiral, float phi)
+{
+    float i = std::round((phi - spiral.phiStart) / spiral.phiStep);
+    return static_cast<uint32_t>(std::clamp(i, 0.0f, static_cast<float>(spiral.count - 1)));
+}
+
+// Inverts r = a * e^(k * phi) so the sample closest to a loop radius costs no search
+uint32_t spiralIndexAtRadius(const LogSpiral& spiral, float radius)
+{
+    if (radius <= 0.0f || spiral.k == 0.0f)
+    {
+        return 0;
+    }
+    return spiralIndexAtAngle(spiral, std::log(radius / spiral.a) / spiral.k);
+}
+
+float spiralDistance2(const LogSpiral& spiral, uint32_t index, glm::vec2 point)
+{
+    glm::vec2 offset = spiralPoint(spiral, index) - point;
+    return glm::dot(offset, offset);
+}
+
+// The closest sample lies near the spiral turn through the point's polar angle whose radius is nearest,
+// so only that turn and its neighbours are checked, each refined by walking to the locally closest sample
+uint32_t spiralIndexNearest(const LogSpiral& spiral, glm::vec2 point)
+{
+    glm::vec2 local = rotate(point - spiral.center, -spiral.rotation);
+    float radius = glm::length(local);
+    if (radius <= 0.0f || spiral.k == 0.0f)
+    {
+        return 0;
+    }
+    float theta = std::atan2(local.y, local.x);
+    float phiAtRadius = std::log(radius / spiral.a) / spiral.k;
+    float turn = std::round((phiAtRadius - theta) / TWO_PI);
+
+    uint32_t best = 0;
+    float bestDistance = INFINITY;
+    for (int t = -1; t <= 1; t++)
+    {
+        uint32_t i = spiralIndexAtAngle(spiral, theta + TWO_PI * (turn + t));
+        float distance = spiralDistance2(spiral, i, point);
+        while (i > 0 && spiralDistance2(spiral, i - 1, point) < distance)
+        {
+            distance = spiralDistance2(spiral, --i, point);
+        }
+        while (i + 1 < spiral.count && spiralDistance2(spiral, i + 1, point) < distance)
+        {
+            distance = spiralDistance2(spiral, ++i, point);
+        }
+        if (distance < bestDistance)
+        {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+    return best;
+}
+
+uint64_t markerCell(const MarkerIndex& index, glm::vec2 position)
+{
+    int32_t x = static_cast<int32_t>(std::floor(position.x / index.cellSize));
+    int32_t y = static_cast<int32_t>(std::floor(position.y / index.cellSize));
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+MarkerCellRef& markerCellRef(MarkerIndex& index, flecs::entity_t marker)
+{
+    uint32_t slot = static_cast<uint32_t>(marker);
+    if (slot >= index.cellOf.size())
+    {
+        index.cellOf.resize(std::max<size_t>(slot + 1, index.cellOf.size() * 2));
+    }
+    return index.cellOf[slot];
+}
+
+void removeMarker(MarkerIndex& index, flecs::entity_t marker)
+{
+    MarkerCellRef& ref = markerCellRef(index, marker);
+    if (!ref.indexed)
+    {
+        return;
+    }
+    auto& cell = index.cells[ref.cell];
+    for (size_t i = 0; i < cell.size(); i++)
+    {
+        if (cell[i].marker == marker)
+        {
+            cell[i] = cell.back();
+            cell.pop_back();
+            break;
+        }
+    }
+    ref.indexed = false;
+}
+
+void insertMarker(MarkerIndex& index, flecs::entity_t marker, glm::vec2 position)
+{
+    removeMarker(index, marker);
+    uint64_t cell = markerCell(index, position);
+    index.cells[cell].push_back({position, marker});
+    markerCellRef(index, marker) = {cell, true};
+}
+
+// Calls visit(entries) for every non-empty cell overlapping [min, max] whose row falls in this shard,
+// so several threads can split the visible cells between them. Sparse indices are walked directly
+// instead of probing every cell in view.
+template<typename Visit>
+void visitMarkerCells(const MarkerIndex& index, glm::vec2 min, glm::vec2 max, uint32_t shard, uint32_t shards, Visit visit)
+{
+    int32_t minX = static_cast<int32_t>(std::floor(min.x / index.cellSize));
+    int32_t maxX = static_cast<int32_t>(std::floor(max.x / index.cellSize));
+    int32_t minY = static_cast<int32_t>(std::floor(min.y / index.cellSize));
+    int32_t maxY = static_cast<int32_t>(std::floor(max.y / index.cellSize));
+    uint64_t inView = static_cast<uint64_t>(maxX - minX + 1) * static_cast<uint64_t>(maxY - minY + 1);
+    if (inView > index.cells.size())
+    {
+        for (const auto& [key, entries] : index.cells)
+        {
+            int32_t x = static_cast<int32_t>(key >> 32);
+            int32_t y = static_cast<int32_t>(key & 0xFFFFFFFFu);
+            if (x >= minX && x <= maxX && y >= minY && y <= maxY && static_cast<uint32_t>(y) % shards == shard && !entries.empty())
+            {
+                visit(entries);
+            }
+        }
+        return;
+    }
+    for (int32_t y = minY; y <= maxY; y++)
+    {
+        if (static_cast<uint32_t>(y) % shards != shard)
+        {
+            continue;
+        }
+        for (int32_t x = minX; x <= maxX; x++)
+        {
+            auto cell = index.cells.find((static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y));
+            if (cell != index.cells.end() && !cell->second.empty())
+            {
+                visit(cell->second);
+            }
+        }
+    }
+}
+
+// Returns 0 when no marker lies within maxDistance
+flecs::entity_t nearestMarker(const MarkerIndex& index, glm::vec2 point, float maxDistance)
+{
+    // Only cells overlapping the query box are visited
+    int32_t minX = static_cast<int32_t>(std::floor((point.x - maxDistance) / index.cellSize));
+    int32_t maxX = static_cast<int32_t>(std::floor((point.x + maxDistance) / index.cellSize));
+    int32_t minY = static_cast<int32_t>(std::floor((point.y - maxDistance) / index.cellSize));
+    int32_t maxY = static_cast<int32_t>(std::floor((point.y + maxDistance) / index.cellSize));
+
+    flecs::entity_t best = 0;
+    float bestDistance = maxDistance * maxDistance;
+    for (int32_t x = minX; x <= maxX; x++)
+    {
+        for (int32_t y = minY; y <= maxY; y++)
+        {
+            // Skip cells that cannot beat the current best before touching their memory
+            float dx = std::max({x * index.cellSize - point.x, point.x - (x + 1) * index.cellSize, 0.0f});
+            float dy = std::max({y * index.cellSize - point.y, point.y - (y + 1) * index.cellSize, 0.0f});
+            if (dx * dx + dy * dy > bestDistance)
+            {
+                continue;
+            }
+            auto cell = index.cells.find((static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y));
+            if (cell == index.cells.end())
+            {
+                continue;
+            }
+            for (const auto& entry : cell->second)
+            {
+                glm::vec2 offset = entry.position - point;
+                float distance = glm::dot(offset, offset);
+                if (distance <= bestDistance)
+                {
+                    bestDistance = distance;
+                    best = entry.marker;
+                }
+            }
+        }
+    }
+    return best;
+}
@@ -4,20 +4,35 @@
 #include <spdlog/spdlog.h>
 #include <string.h>
 #include <set>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include "components.h"
 #include "callback.h"
 #include "vkutil.h"
+#include "spatial.h"
+#include "geometry.h"
+#include "capture.h"
+#include "input.h"
+#include "layers.h"
+#include "snapshot.h"
+#include "history.h"
 
 #include "gpu/vk/GrVkBackendContext.h"
 #include "gpu/vk/GrVkExtensions.h"
 #include "gpu/GrDirectContext.h"
 #include "core/SkColorSpace.h"
 #include "core/SkCanvas.h"
+#include "core/SkPaint.h"
+#include "private/chromium/GrVkSecondaryCBDrawContext.h"
 
 void CreateWindow(flecs::entity e, Window& window)
 {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     window.object = glfwCreateWindow(800, 600, EDITOR_NAME, nullptr, nullptr);
+    // Framebuffer pixels per window unit, above one on high DPI displays
+    float contentScaleY;
+    glfwGetWindowContentScale(window.object, &window.contentScale, &contentScaleY);
 }
 
 void PollEvents(flecs::iter& it)
@@ -25,6 +40,55 @@ void PollEvents(flecs::iter& it)
     glfwPollEvents();
 }
 
+void ListenForInput(flecs::entity e, InputState& input)
+{
+    const Window* window = e.get<Window>();
+    glfwSetWindowUserPointer(window->object, input.queue.get());
+    glfwSetCursorPosCallback(window->object, onCursorPos);
+    glfwSetMouseButtonCallback(window->object, onMouseButton);
+    glfwSetKeyCallback(window->object, onKey);
+    glfwSetScrollCallback(window->object, onScroll);
+}
+
+// Turns this frame's events into InputState. Recording appends them to the log with the frame's
+// delta time; replay swaps GLFW's events for the logged ones and closes the window when the log ends.
+void ApplyInput(flecs::iter& it, InputState* input, InputSession* session, const Window* window, FrameCapture* capture)
+{
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < it.count(); i++)
+    {
+        std::vector<InputEvent>& events = *input[i].queue;
+        InputSession& s = session[i];
+        if (s.mode == InputMode::Replay && !s.finished)
+        {
+            if (s.lastFrame != std::chrono::steady_clock::time_point{})
+            {
+                float stalled = capture[i].stalledMilliseconds;
+                s.frameMilliseconds.push_back(std::chrono::duration<float, std::milli>(now - s.lastFrame).count() - stalled);
+                s.captureStallMilliseconds += stalled;
+            }
+            capture[i].stalledMilliseconds = 0.0f;
+            s.lastFrame = now;
+
+            events.clear();
+            float deltaSeconds;
+            if (!readInputFrame(*s.reader, deltaSeconds, events))
+            {
+                s.reader->offset = s.reader->data.size();
+                s.finished = true;
+                reportFrameTimes(s.frameMilliseconds, s.reportPath, s.captureStallMilliseconds);
+                glfwSetWindowShouldClose(window[i].object, GLFW_TRUE);
+            }
+        }
+        else if (s.mode == InputMode::Record)
+        {
+            writeInputFrame(*s.writer, static_cast<float>(it.delta_time()), events);
+        }
+        applyInputEvents(input[i], events);
+        events.clear();
+    }
+}
+
 void CloseWindow(flecs::iter& it, Window* window)
 {
     int closed = 0;
@@ -49,6 +113,14 @@ void DestroyWindow(flecs::entity e, Window& window)
 
 void SetupFramework(flecs::entity e, PlatformFramework& pf)
 {
+    if (e.has<Headless>())
+    {
+#ifdef GLFW_PLATFORM_NULL
+        // The null platform reports VK_EXT_headless_surface as its required instance extension.
+        // buildEditor refuses headless runs on older GLFW before getting here.
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    }
     glfwInit();
 
     VkApplicationInfo appInfo{};
@@ -89,7 +161,7 @@ void SetupFramework(flecs::entity e, PlatformFramework& pf)
     }
 
     VkResult result;
-    if ((result = vkCreateInstance(&createInfo, nullptr, &pf.instance)) != VK_SUCCESS)
+    if ((result = vkCreateInstance(&createInfo, vkAllocator(VK_OBJECT_TYPE_INSTANCE), &pf.instance)) != VK_SUCCESS)
     {
         spdlog::error("Failed to create Vulkan instance. Error code {}", result);
     }
@@ -100,7 +172,7 @@ void SetupFramework(flecs::entity e, PlatformFramework& pf)
     dmCreateInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
     dmCreateInfo.pfnUserCallback = debugCallback;
     
-    CreateDebugUtilsMessengerEXT(pf.instance, &dmCreateInfo, nullptr, &pf.debugMessenger);
+    CreateDebugUtilsMessengerEXT(pf.instance, &dmCreateInfo, vkAllocator(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT), &pf.debugMessenger);
     
 }
 
@@ -116,14 +188,23 @@ void SelectPrimaryRenderDevice(flecs::iter& it, PlatformFramework* pf, RenderDev
     }
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(pf->instance, &deviceCount, devices.data());
+
+    // Discrete GPUs win, otherwise the first capable device (e.g. lavapipe) is used
+    bool selected = false;
     for (const auto& device : devices)
     {
         VkPhysicalDeviceProperties deviceProperties;
         vkGetPhysicalDeviceProperties(device, &deviceProperties);
         VkPhysicalDeviceFeatures deviceFeatures;
         vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+        VkBool32 bindlessSupported = checkDescriptorIndexingSupport(device);
 
         bool hasGraphics = false;
+        bool hasPresent = false;
+        bool hasDedicatedCompute = false;
+        uint32_t graphicsFamily = 0;
+        uint32_t presentFamily = 0;
+        uint32_t computeFamily = 0;
 
         uint32_t queueFamilyCount = 0;
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
@@ -131,61 +212,66 @@ void SelectPrimaryRenderDevice(flecs::iter& it, PlatformFramework* pf, RenderDev
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
         VkBool32 extensionsSupported = checkDeviceExtensionSupport(pf, device);
-        VkBool32 swapChainAdequate = false;
-        if (extensionsSupported)
-        {   
-            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, window->surface, &window->capabilities);
-            uint32_t formatCount;
-            vkGetPhysicalDeviceSurfaceFormatsKHR(device, window->surface, &formatCount, nullptr);
-            if (formatCount != 0)
-            {
-                window->formats.resize(formatCount);
-                vkGetPhysicalDeviceSurfaceFormatsKHR(device, window->surface, &formatCount, window->formats.data());
-            }
-
-            uint32_t presentModeCount;
-            vkGetPhysicalDeviceSurfacePresentModesKHR(device, window->surface, &presentModeCount, nullptr);
-
-            if (presentModeCount != 0) {
-                window->presentModes.resize(presentModeCount);
-                vkGetPhysicalDeviceSurfacePresentModesKHR(device, window->surface, &presentModeCount, window->presentModes.data());
-            }
-            swapChainAdequate = !window->formats.empty() && !window->presentModes.empty();
-
-        }
+        VkBool32 swapChainAdequate = extensionsSupported && querySurfaceSupport(device, window);
 
         VkBool32 canPresent = false;
-        int i = 0;
+        uint32_t i = 0;
         for (const auto& queueFamily : queueFamilies)
         {
             if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
             {
-                rd->graphicsFamily = i;
+                graphicsFamily = i;
                 hasGraphics = true;
             }
+            else if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)
+            {
+                computeFamily = i;
+                hasDedicatedCompute = true;
+            }
             vkGetPhysicalDeviceSurfaceSupportKHR(device, i, window->surface, &canPresent);
             if (canPresent)
             {
-                rd->presentFamily = i;
+                presentFamily = i;
+                hasPresent = true;
             }
             i++;
         }
 
-        if (hasGraphics && deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
-        deviceFeatures.geometryShader && extensionsSupported && swapChainAdequate)
+        if (!(hasGraphics && hasPresent && deviceFeatures.geometryShader && extensionsSupported && swapChainAdequate && bindlessSupported))
+        {
+            continue;
+        }
+        bool discrete = deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+        if (!selected || discrete)
         {
-            spdlog::info("Selected primary render device {}", deviceProperties.deviceName);
             rd->physical = device;
+            rd->graphicsFamily = graphicsFamily;
+            rd->presentFamily = presentFamily;
+            // Graphics queues always support compute, so the graphics family is the fallback
+            rd->computeFamily = hasDedicatedCompute ? computeFamily : graphicsFamily;
+            rd->timestampPeriod = queueFamilies[graphicsFamily].timestampValidBits > 0 ? deviceProperties.limits.timestampPeriod : 0.0f;
+            selected = true;
+            spdlog::info("Selected primary render device {}", deviceProperties.deviceName);
+        }
+        if (discrete)
+        {
             break;
         }
+    }
 
+    if (!selected)
+    {
+        spdlog::error("Failed to find a suitable render device");
+        return;
     }
+    // Surface details were overwritten while probing other devices
+    querySurfaceSupport(rd->physical, window);
 }
 
 void SpecifyLogicalDevice(flecs::entity e, PlatformFramework& pf, RenderDevice& rd)
 {
     spdlog::info("Specify logical device");
-    std::set<uint32_t> distinctQueueFamilies = {rd.graphicsFamily, rd.presentFamily};
+    std::set<uint32_t> distinctQueueFamilies = {rd.graphicsFamily, rd.presentFamily, rd.computeFamily};
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos(distinctQueueFamilies.size());
     int i = 0;
@@ -202,8 +288,20 @@ void SpecifyLogicalDevice(flecs::entity e, PlatformFramework& pf, RenderDevice&
     }
 
     VkPhysicalDeviceFeatures deviceFeatures{};
+
+    // Descriptor indexing is core in Vulkan 1.2 but each feature must still be enabled
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &indexingFeatures;
     createInfo.pQueueCreateInfos = &queueCreateInfos.data()[0];
     createInfo.queueCreateInfoCount = queueCreateInfos.size();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -211,12 +309,17 @@ void SpecifyLogicalDevice(flecs::entity e, PlatformFramework& pf, RenderDevice&
     createInfo.ppEnabledExtensionNames = pf.deviceExtensions.data();
     createInfo.enabledLayerCount = 0; // device only validation layers depreciated
     VkResult result;
-    if ((result = vkCreateDevice(rd.physical, &createInfo, nullptr, &rd.logical)) != VK_SUCCESS)
+    if ((result = vkCreateDevice(rd.physical, &createInfo, vkAllocator(VK_OBJECT_TYPE_DEVICE), &rd.logical)) != VK_SUCCESS)
     {
         spdlog::error("Failed to create logical device {}", result);
     }
     vkGetDeviceQueue(rd.logical, rd.graphicsFamily, 0, &rd.graphicsQueue);
     vkGetDeviceQueue(rd.logical, rd.presentFamily, 0, &rd.presentQueue);
+    vkGetDeviceQueue(rd.logical, rd.computeFamily, 0, &rd.computeQueue);
+    if (rd.computeFamily != rd.graphicsFamily)
+    {
+        spdlog::info("Using dedicated compute queue family {}", rd.computeFamily);
+    }
 }
 
 void CreateSwapChain(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
@@ -239,6 +342,10 @@ void CreateSwapChain(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // Frame capture copies presented images out, which most surfaces allow
+    if (window->capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
 
     uint32_t queueFamilyIndices[] = {rd->graphicsFamily, rd->presentFamily};
 
@@ -257,7 +364,7 @@ void CreateSwapChain(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
     createInfo.clipped = VK_TRUE;
     createInfo.oldSwapchain = VK_NULL_HANDLE;
     VkResult result;
-    if ((result = vkCreateSwapchainKHR(rd->logical, &createInfo, nullptr, &window->swapChain)) != VK_SUCCESS)
+    if ((result = vkCreateSwapchainKHR(rd->logical, &createInfo, vkAllocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR), &window->swapChain)) != VK_SUCCESS)
     {
         spdlog::error("Failed to create swapchain");
     }
@@ -283,7 +390,7 @@ void CreateSwapChain(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
         createInfo.subresourceRange.levelCount = 1;
         createInfo.subresourceRange.baseArrayLayer = 0;
         createInfo.subresourceRange.layerCount = 1;
-        if (vkCreateImageView(rd->logical, &createInfo, nullptr, &window->swapChainImageViews[i]) != VK_SUCCESS)
+        if (vkCreateImageView(rd->logical, &createInfo, vkAllocator(VK_OBJECT_TYPE_IMAGE_VIEW), &window->swapChainImageViews[i]) != VK_SUCCESS)
         {
             spdlog::error("Failed to create swapchain image views");
         }
@@ -294,50 +401,114 @@ void CreateSwapChain(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
 void CreateRenderPass(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
 {
     auto window = it.term<Window>(3);
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = window->swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-
-    VkSubpassDependency dependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    VkRenderPassCreateInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-    if (vkCreateRenderPass(rd->logical, &renderPassInfo, nullptr, &window->renderPass) != VK_SUCCESS)
+    window->renderPass = createColorRenderPass(rd, window->swapChainImageFormat, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    if (window->renderPass == VK_NULL_HANDLE)
     {
         spdlog::error("Failed to create render pass");
     }
-
 }
 
+void CreateBindlessTextureTable(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
+{
+    auto window = it.term<Window>(3);
+    spdlog::info("Create bindless texture table");
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(rd->physical, &properties);
+    // The whole table is visible to the fragment stage, so the per-stage limit applies too and is
+    // often far lower than the per-set one
+    uint32_t capacity = std::min<uint32_t>({MAX_BINDLESS_TEXTURES,
+        indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(rd->logical, &samplerInfo, vkAllocator(VK_OBJECT_TYPE_SAMPLER), &window->bindlessSampler) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create bindless sampler");
+    }
+
+    // Binding 0 is a single immutable sampler, binding 1 the variable-sized texture array (must be last)
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[0].pImmutableSamplers = &window->bindlessSampler;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    bindings[1].descriptorCount = capacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlags bindingFlags[2] = {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = 2;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(rd->logical, &layoutInfo, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &window->bindlessLayout) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create bindless descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    poolSizes[1].descriptorCount = capacity;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(rd->logical, &poolInfo, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &window->bindlessPool) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create bindless descriptor pool");
+    }
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+    variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+    variableCountInfo.descriptorSetCount = 1;
+    variableCountInfo.pDescriptorCounts = &capacity;
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = &variableCountInfo;
+    allocInfo.descriptorPool = window->bindlessPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &window->bindlessLayout;
+    if (vkAllocateDescriptorSets(rd->logical, &allocInfo, &window->bindlessSet) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to allocate bindless descriptor set");
+    }
+
+    window->textureSlots.capacity = capacity;
+    window->textureSlots.next = 0;
+    window->textureSlots.freed.clear();
+}
 
 void CreateGraphicsPipeline(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
 {
@@ -438,8 +609,10 @@ void CreateGraphicsPipeline(flecs::iter& it, PlatformFramework* pf, RenderDevice
     colorBlending.blendConstants[2] = 0.0f; // Optional
     colorBlending.blendConstants[3] = 0.0f; // Optional
 
+    // The scene may render into a scaled sub-rectangle of its target, so viewport and scissor are per command buffer
     std::vector<VkDynamicState> dynamicStates = {
         VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
     };
 
     VkPipelineDynamicStateCreateInfo dynamicState{};
@@ -447,14 +620,19 @@ void CreateGraphicsPipeline(flecs::iter& it, PlatformFramework* pf, RenderDevice
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawPushConstants);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0; // Optional
-    pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &window->bindlessLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-    if (vkCreatePipelineLayout(rd->logical, &pipelineLayoutInfo, nullptr, &window->pipelineLayout) != VK_SUCCESS) {
+    if (vkCreatePipelineLayout(rd->logical, &pipelineLayoutInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &window->pipelineLayout) != VK_SUCCESS) {
         spdlog::error("Failed to create pipeline layout");
     }
 
@@ -469,21 +647,169 @@ void CreateGraphicsPipeline(flecs::iter& it, PlatformFramework* pf, RenderDevice
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pDepthStencilState = nullptr; // Optional
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = nullptr; // Optional
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = window->pipelineLayout;
     pipelineInfo.renderPass = window->renderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex = -1;
 
-    if (vkCreateGraphicsPipelines(rd->logical, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &window->graphicsPipeline) != VK_SUCCESS)
+    if (vkCreateGraphicsPipelines(rd->logical, VK_NULL_HANDLE, 1, &pipelineInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE), &window->graphicsPipeline) != VK_SUCCESS)
     {
         spdlog::error("Failed to create graphics pipeline");
     }
 
-    vkDestroyShaderModule(rd->logical, fragShaderModule, nullptr);
-    vkDestroyShaderModule(rd->logical, vertShaderModule, nullptr);
+    vkDestroyShaderModule(rd->logical, fragShaderModule, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE));
+    vkDestroyShaderModule(rd->logical, vertShaderModule, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE));
+
+}
+
+void CreateLinePipeline(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
+{
+    auto window = it.term<Window>(3);
+    window->linePipeline = VK_NULL_HANDLE;
+
+    auto vertShaderCode = readFile("../res/shaders/line_vert.spv");
+    auto fragShaderCode = readFile("../res/shaders/line_frag.spv");
+    if (vertShaderCode.empty() || fragShaderCode.empty())
+    {
+        spdlog::error("Line shaders missing, run res/shaders/compile.sh");
+        return;
+    }
+
+    VkShaderModule vertShaderModule = createShaderModule(rd->logical, vertShaderCode);
+    VkShaderModule fragShaderModule = createShaderModule(rd->logical, fragShaderCode);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    // Both bindings step per instance over the same buffer, offset by one vertex at bind time
+    VkVertexInputBindingDescription bindingDescriptions[2]{};
+    VkVertexInputAttributeDescription attributeDescriptions[10]{};
+    for (uint32_t end = 0; end < 2; end++)
+    {
+        bindingDescriptions[end].binding = end;
+        bindingDescriptions[end].stride = sizeof(LineVertex);
+        bindingDescriptions[end].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        VkVertexInputAttributeDescription* attributes = &attributeDescriptions[end * 5];
+        attributes[0] = {end * 5 + 0, end, VK_FORMAT_R32G32_SFLOAT, offsetof(LineVertex, position)};
+        attributes[1] = {end * 5 + 1, end, VK_FORMAT_R32_SFLOAT, offsetof(LineVertex, distance)};
+        attributes[2] = {end * 5 + 2, end, VK_FORMAT_R32_SFLOAT, offsetof(LineVertex, width)};
+        attributes[3] = {end * 5 + 3, end, VK_FORMAT_R8G8B8A8_UNORM, offsetof(LineVertex, color)};
+        attributes[4] = {end * 5 + 4, end, VK_FORMAT_R32G32_SFLOAT, offsetof(LineVertex, dash)};
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+    vertexInputInfo.vertexAttributeDescriptionCount = 10;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkViewport viewport{};
+    viewport.width = (float) window->swapChainExtent.width;
+    viewport.height = (float) window->swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = window->swapChainExtent;
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    // Quads are expanded on either side of the segment, so winding varies and nothing is culled
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading = 1.0f;
+
+    // Coverage comes from the fragment shader as alpha, blended premultiplied-style over the scene
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(LinePushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(rd->logical, &pipelineLayoutInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &window->linePipelineLayout) != VK_SUCCESS) {
+        spdlog::error("Failed to create line pipeline layout");
+    }
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = window->linePipelineLayout;
+    pipelineInfo.renderPass = window->renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(rd->logical, VK_NULL_HANDLE, 1, &pipelineInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE), &window->linePipeline) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create line pipeline");
+    }
 
+    vkDestroyShaderModule(rd->logical, fragShaderModule, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE));
+    vkDestroyShaderModule(rd->logical, vertShaderModule, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE));
 }
 
 void CreateSkiaSurface(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd, SkiaGPU* skgpu)
@@ -502,7 +828,7 @@ void CreateSkiaSurface(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd,
     extensions->init(getProc, pf->instance, rd->physical, pf->extensions.size(), pf->extensions.data(), pf->deviceExtensions.size(), pf->deviceExtensions.data());
     backend.fVkExtensions = extensions.get();
     backend.fGetProc = getProc;
-    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceFeatures features{};
     features.geometryShader = true;
     backend.fDeviceFeatures = &features;
     backend.fProtectedContext = GrProtected::kNo;
@@ -512,36 +838,26 @@ void CreateSkiaSurface(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd,
         spdlog::error("Failed to create Skia Vulkan context");
     }
 
+    // Skia records into secondary command buffers executed inside our render pass, one per swapchain image
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = window->commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(window->swapChainImages.size());
 
-    // High DPI???
-    int width, height;
-    glfwGetWindowSize(window->object, &width, &height);
-    GrVkImageInfo renderTargetInfo;
-    renderTargetInfo.fImage = window->swapChainImages[0];
-    renderTargetInfo.fFormat = window->swapChainImageFormat;
-    renderTargetInfo.fLevelCount = 1;
-
-    GrVkYcbcrConversionInfo conversionInfo;
-    conversionInfo.fFormat = window->swapChainImageFormat;
-    renderTargetInfo.fYcbcrConversionInfo = conversionInfo;
-
-    skgpu->rt = new GrBackendRenderTarget(width, height, renderTargetInfo);
-    if (!skgpu->rt->isValid())
+    skgpu->commandBuffers.resize(window->swapChainImages.size());
+    if (vkAllocateCommandBuffers(rd->logical, &allocInfo, skgpu->commandBuffers.data()) != VK_SUCCESS)
     {
-        spdlog::error("Failed to create Skia render target");
+        spdlog::error("Failed to allocate Skia command buffers");
     }
-    GrSurfaceOrigin origin;
-    SkColorType colorType = kBGRA_8888_SkColorType;
-    sk_sp<SkColorSpace> colorSpace = SkColorSpace::MakeSRGB();
-    SkSurfaceProps surfaceProps;
-    skgpu->surface = SkSurface::MakeFromBackendRenderTarget(skgpu->vkContext.get(), *skgpu->rt, origin, colorType, colorSpace, &surfaceProps);
-    if (!skgpu->surface)
-    {
-        spdlog::error("Failed to create Skia surface");
-    }
-    skgpu->surface->getCanvas()->clear(SK_ColorRED);
-}
 
+    skgpu->imageInfo = SkImageInfo::Make(window->swapChainExtent.width, window->swapChainExtent.height,
+        skiaColorType(window->swapChainImageFormat), kPremul_SkAlphaType, SkColorSpace::MakeSRGB());
+
+    // The render thread records too, so one worker fewer than there are cores
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    skgpu->recorders = startSkiaRecorders(std::min<uint32_t>(cores - 1, FLECS_THREAD_COUNT - 1));
+}
 
 void CreateFramebuffers(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
 {
@@ -561,7 +877,7 @@ void CreateFramebuffers(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd
         framebufferInfo.height = window->swapChainExtent.height;
         framebufferInfo.layers = 1;
 
-        if (vkCreateFramebuffer(rd->logical, &framebufferInfo, nullptr, &window->swapChainFramebuffers[i]) != VK_SUCCESS) 
+        if (vkCreateFramebuffer(rd->logical, &framebufferInfo, vkAllocator(VK_OBJECT_TYPE_FRAMEBUFFER), &window->swapChainFramebuffers[i]) != VK_SUCCESS) 
         {
             spdlog::error("Failed to create framebuffer");
         }
@@ -578,7 +894,7 @@ void CreateCommandPool(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     poolInfo.queueFamilyIndex = rd->graphicsFamily;
 
-    if (vkCreateCommandPool(rd->logical, &poolInfo, nullptr, &window->commandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(rd->logical, &poolInfo, vkAllocator(VK_OBJECT_TYPE_COMMAND_POOL), &window->commandPool) != VK_SUCCESS) {
         spdlog::error("Failed to create command pool");
     }
 
@@ -586,124 +902,1320 @@ void CreateCommandPool(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = window->commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 1;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(window->swapChainImages.size());
 
-    if (vkAllocateCommandBuffers(rd->logical, &allocInfo, &window->commandBuffer) != VK_SUCCESS) {
+    window->commandBuffers.resize(window->swapChainImages.size());
+    if (vkAllocateCommandBuffers(rd->logical, &allocInfo, window->commandBuffers.data()) != VK_SUCCESS) {
         spdlog::error("Failed to allocate command buffers");
     }
 
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    window->sceneCommandBuffers.resize(window->swapChainImages.size());
+    if (vkAllocateCommandBuffers(rd->logical, &allocInfo, window->sceneCommandBuffers.data()) != VK_SUCCESS) {
+        spdlog::error("Failed to allocate scene command buffers");
+    }
+    window->recordedVersions.assign(window->commandBuffers.size(), UINT64_MAX);
+    window->sceneVersion = 0;
+
 }
 
-void CreateSyncObjects(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
+// The scene renders into an offscreen target that is upscaled into the swapchain image, so its
+// resolution can follow GPU load. Creates the target, its render pass, the upscale pipeline and the timestamp queries.
+void CreateSceneTarget(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
 {
     auto window = it.term<Window>(3);
-    spdlog::info("Create sync objects");
-
-    VkSemaphoreCreateInfo semaphoreInfo{};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    auto resolution = it.term<const DynamicResolution>(4);
+    SceneTarget& target = window->sceneTarget;
+    spdlog::info("Create scene target");
+
+    target.allocatedExtent.width = std::max(1u, static_cast<uint32_t>(std::ceil(window->swapChainExtent.width * resolution->maxScale)));
+    target.allocatedExtent.height = std::max(1u, static_cast<uint32_t>(std::ceil(window->swapChainExtent.height * resolution->maxScale)));
+    target.renderExtent = target.allocatedExtent;
+
+    // Compatible with the swapchain pass so secondaries recorded against either run in both,
+    // but it ends ready to be sampled by the upscale pass
+    target.renderPass = createColorRenderPass(rd, window->swapChainImageFormat, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    if (target.renderPass == VK_NULL_HANDLE)
+    {
+        spdlog::error("Failed to create scene target render pass");
+    }
 
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = window->swapChainImageFormat;
+    imageInfo.extent = {target.allocatedExtent.width, target.allocatedExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(rd->logical, &imageInfo, vkAllocator(VK_OBJECT_TYPE_IMAGE), &target.image) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create scene target image");
+        return;
+    }
 
-    if (vkCreateSemaphore(rd->logical, &semaphoreInfo, nullptr, &window->imageAvailableSemaphore) != VK_SUCCESS ||
-        vkCreateSemaphore(rd->logical, &semaphoreInfo, nullptr, &window->renderFinishedSemaphore) != VK_SUCCESS ||
-        vkCreateFence(rd->logical, &fenceInfo, nullptr, &window->inFlightFence) != VK_SUCCESS) {
-        spdlog::error("Failed to create semaphores");
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(rd->logical, target.image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(rd->physical, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkAllocateMemory(rd->logical, &allocInfo, vkAllocator(VK_OBJECT_TYPE_DEVICE_MEMORY), &target.memory) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to allocate scene target memory");
+        return;
+    }
+    vkBindImageMemory(rd->logical, target.image, target.memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = target.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = window->swapChainImageFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(rd->logical, &viewInfo, vkAllocator(VK_OBJECT_TYPE_IMAGE_VIEW), &target.view) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create scene target image view");
     }
-}
 
-void ShutdownFramework(flecs::entity e, PlatformFramework& pf, RenderDevice& rd)
-{
-    vkDestroyDevice(rd.logical, nullptr);
-    DestroyDebugUtilsMessengerEXT(pf.instance, pf.debugMessenger, nullptr);
-    vkDestroyInstance(pf.instance, nullptr);
-    glfwTerminate();
-    e.world().quit();
-}
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = target.renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &target.view;
+    framebufferInfo.width = target.allocatedExtent.width;
+    framebufferInfo.height = target.allocatedExtent.height;
+    framebufferInfo.layers = 1;
+    if (vkCreateFramebuffer(rd->logical, &framebufferInfo, vkAllocator(VK_OBJECT_TYPE_FRAMEBUFFER), &target.framebuffer) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create scene target framebuffer");
+    }
 
-void RenderSkiaTest(flecs::iter& it, SkiaGPU* skgpu)
-{
-    // spdlog::info("Render skia");
-    // skgpu->vkContext->submit();
-}
+    // The upscale pass samples the target through the bindless table like any other texture
+    target.textureSlot = allocateTextureSlot(window->textureSlots);
+    if (target.textureSlot != NO_TEXTURE_SLOT)
+    {
+        writeTextureSlot(rd->logical, window->bindlessSet, target.textureSlot, target.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
 
-void RenderFrame(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
-{
-    auto window = it.term<Window>(3);
-    vkWaitForFences(rd->logical, 1, &window->inFlightFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(rd->logical, 1, &window->inFlightFence);
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(rd->logical, window->swapChain, UINT64_MAX, window->imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-    vkResetCommandBuffer(window->commandBuffer, 0);
-    recordCommandBuffer(window->commandBuffer, imageIndex, &*window);
+    VkCommandBufferAllocateInfo commandAllocInfo{};
+    commandAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandAllocInfo.commandPool = window->commandPool;
+    commandAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    commandAllocInfo.commandBufferCount = static_cast<uint32_t>(window->swapChainImages.size());
+    target.upscaleCommandBuffers.resize(window->swapChainImages.size());
+    if (vkAllocateCommandBuffers(rd->logical, &commandAllocInfo, target.upscaleCommandBuffers.data()) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to allocate upscale command buffers");
+    }
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (rd->timestampPeriod > 0.0f)
+    {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2;
+        if (vkCreateQueryPool(rd->logical, &queryPoolInfo, vkAllocator(VK_OBJECT_TYPE_QUERY_POOL), &target.timestampPool) != VK_SUCCESS)
+        {
+            spdlog::error("Failed to create timestamp query pool");
+        }
+    }
+    else
+    {
+        spdlog::info("Graphics queue has no timestamps, resolution scale stays fixed");
+    }
 
-    VkSemaphore waitSemaphores[] = {window->imageAvailableSemaphore};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &window->commandBuffer;
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(UpscalePushConstants);
 
-    VkSemaphore signalSemaphores[] = {window->renderFinishedSemaphore};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &window->bindlessLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(rd->logical, &pipelineLayoutInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &target.upscalePipelineLayout) != VK_SUCCESS) {
+        spdlog::error("Failed to create upscale pipeline layout");
+    }
 
-    if (vkQueueSubmit(rd->graphicsQueue, 1, &submitInfo, window->inFlightFence) != VK_SUCCESS) {
-        spdlog::error("Failed to submit draw command buffer");
+    target.upscalePipeline = VK_NULL_HANDLE;
+    auto vertShaderCode = readFile("../res/shaders/upscale_vert.spv");
+    auto fragShaderCode = readFile("../res/shaders/upscale_frag.spv");
+    if (vertShaderCode.empty() || fragShaderCode.empty())
+    {
+        spdlog::error("Upscale shaders missing, run res/shaders/compile.sh");
+        return;
     }
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    VkShaderModule vertShaderModule = createShaderModule(rd->logical, vertShaderCode);
+    VkShaderModule fragShaderModule = createShaderModule(rd->logical, fragShaderCode);
 
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
 
-    VkSwapchainKHR swapChains[] = {window->swapChain};
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    vkQueuePresentKHR(rd->presentQueue, &presentInfo);
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-}
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
 
-void CreateWindowSurface(flecs::iter& it, Window* window)
-{
-    auto pf = it.term<const PlatformFramework>(2);
-    auto rd = it.term<const RenderDevice>(3);
-    spdlog::info("Create window surface");
-    VkResult result;
-    if ((result = glfwCreateWindowSurface(pf->instance, window->object, nullptr, &window->surface)) != VK_SUCCESS)
-    {
-        spdlog::error("Failed to create window surface {}", result);
-    }
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
 
-}
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading = 1.0f;
 
-void DestroyWindowSurface(flecs::iter it, Window* window)
-{
+    // The upscaled scene is the bottom layer, it replaces the cleared color outright
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = target.upscalePipelineLayout;
+    pipelineInfo.renderPass = window->renderPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(rd->logical, VK_NULL_HANDLE, 1, &pipelineInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE), &target.upscalePipeline) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create upscale pipeline");
+    }
+
+    vkDestroyShaderModule(rd->logical, fragShaderModule, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE));
+    vkDestroyShaderModule(rd->logical, vertShaderModule, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE));
+}
+
+// Allocates the readback ring and starts the writer when a capture path was given
+void CreateFrameCapture(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
+{
+    auto window = it.term<const Window>(3);
+    auto capture = it.term<FrameCapture>(4);
+    if (capture->path.empty())
+    {
+        return;
+    }
+    if (!(window->capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+    {
+        spdlog::error("Surface images can't be copied, frame capture disabled");
+        return;
+    }
+    // Only the byte order matters, the copied bytes of an sRGB image are already the encoded values the display shows
+    bool bgra;
+    switch (window->swapChainImageFormat)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            bgra = false;
+            break;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            bgra = true;
+            break;
+        default:
+            spdlog::error("Frame capture needs an 8 bit RGBA or BGRA swapchain");
+            return;
+    }
+
+    VkExtent2D extent = window->swapChainExtent;
+    capture->writer = startCaptureWriter(capture->format, capture->path, extent.width, extent.height,
+        capture->framesPerSecond, bgra);
+    if (!capture->writer)
+    {
+        return;
+    }
+    spdlog::info("Capturing frames to {}", capture->path);
+
+    // Cached memory keeps host reads of the mapped buffers fast
+    VkMemoryPropertyFlags properties = preferMemoryProperties(rd->physical,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    capture->slots.resize(capture->ringSize);
+    for (auto& slot : capture->slots)
+    {
+        createBuffer(rd, static_cast<VkDeviceSize>(extent.width) * extent.height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer);
+        vkMapMemory(rd->logical, slot.buffer.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped);
+        if (vkCreateFence(rd->logical, &fenceInfo, vkAllocator(VK_OBJECT_TYPE_FENCE), &slot.fence) != VK_SUCCESS) {
+            spdlog::error("Failed to create capture fence");
+        }
+    }
+}
+
+void CreateSyncObjects(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
+{
+    auto window = it.term<Window>(3);
+    spdlog::info("Create sync objects");
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    if (vkCreateSemaphore(rd->logical, &semaphoreInfo, vkAllocator(VK_OBJECT_TYPE_SEMAPHORE), &window->imageAvailableSemaphore) != VK_SUCCESS ||
+        vkCreateSemaphore(rd->logical, &semaphoreInfo, vkAllocator(VK_OBJECT_TYPE_SEMAPHORE), &window->renderFinishedSemaphore) != VK_SUCCESS ||
+        vkCreateFence(rd->logical, &fenceInfo, vkAllocator(VK_OBJECT_TYPE_FENCE), &window->inFlightFence) != VK_SUCCESS) {
+        spdlog::error("Failed to create semaphores");
+    }
+}
+
+void CreateCurveCompute(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd)
+{
+    auto window = it.term<Window>(3);
+    CurveCompute& curves = window->curves;
+    spdlog::info("Create curve compute stage");
+
+    uint32_t families[] = {rd->graphicsFamily, rd->computeFamily};
+    uint32_t familyCount = rd->computeFamily != rd->graphicsFamily ? 2 : 1;
+    createBuffer(rd, sizeof(LineVertex) * MAX_CURVE_VERTICES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, curves.vertices, familyCount, families);
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    if (vkCreateDescriptorSetLayout(rd->logical, &layoutInfo, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &curves.setLayout) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create curve descriptor set layout");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 1;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(rd->logical, &poolInfo, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &curves.descriptorPool) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create curve descriptor pool");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = curves.descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &curves.setLayout;
+    if (vkAllocateDescriptorSets(rd->logical, &allocInfo, &curves.set) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to allocate curve descriptor set");
+    }
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = curves.vertices.buffer;
+    bufferInfo.range = VK_WHOLE_SIZE;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = curves.set;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(rd->logical, 1, &write, 0, nullptr);
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.size = sizeof(CurvePushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &curves.setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(rd->logical, &pipelineLayoutInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &curves.pipelineLayout) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create curve pipeline layout");
+    }
+
+    VkCommandPoolCreateInfo commandPoolInfo{};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = rd->computeFamily;
+    if (vkCreateCommandPool(rd->logical, &commandPoolInfo, vkAllocator(VK_OBJECT_TYPE_COMMAND_POOL), &curves.commandPool) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create curve command pool");
+    }
+    VkCommandBufferAllocateInfo commandBufferInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = curves.commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(rd->logical, &commandBufferInfo, &curves.commandBuffer) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to allocate curve command buffer");
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (vkCreateSemaphore(rd->logical, &semaphoreInfo, vkAllocator(VK_OBJECT_TYPE_SEMAPHORE), &curves.finishedSemaphore) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create curve semaphore");
+    }
+
+    auto shaderCode = readFile("../res/shaders/curve_comp.spv");
+    if (shaderCode.empty())
+    {
+        spdlog::error("Curve shader missing, run res/shaders/compile.sh");
+        return;
+    }
+    VkShaderModule shaderModule = createShaderModule(rd->logical, shaderCode);
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = curves.pipelineLayout;
+    if (vkCreateComputePipelines(rd->logical, VK_NULL_HANDLE, 1, &pipelineInfo, vkAllocator(VK_OBJECT_TYPE_PIPELINE), &curves.pipeline) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create curve pipeline");
+    }
+    vkDestroyShaderModule(rd->logical, shaderModule, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE));
+}
+
+void ShutdownFramework(flecs::entity e, PlatformFramework& pf, RenderDevice& rd)
+{
+    vkDestroyDevice(rd.logical, vkAllocator(VK_OBJECT_TYPE_DEVICE));
+    DestroyDebugUtilsMessengerEXT(pf.instance, pf.debugMessenger, vkAllocator(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT));
+    vkDestroyInstance(pf.instance, vkAllocator(VK_OBJECT_TYPE_INSTANCE));
+    glfwTerminate();
+    logHostMemory("at shutdown");
+    if (hostMemoryStats().total.allocations != 0)
+    {
+        spdlog::warn("{} host allocations were never freed", hostMemoryStats().total.allocations);
+    }
+    e.world().quit();
+}
+
+void ReportHostMemory(flecs::iter& it, HostMemoryReport* report)
+{
+    // Sampling every frame is what keeps the per scope and per type peaks current
+    sampleHostMemory();
+    const HostMemoryStats& stats = hostMemoryStats();
+    for (int i = 0; i < it.count(); i++)
+    {
+        if (++report[i].frames < report[i].intervalFrames)
+        {
+            continue;
+        }
+        uint64_t allocations = stats.total.totalAllocations;
+        uint64_t commandAllocations = stats.scopes[VK_SYSTEM_ALLOCATION_SCOPE_COMMAND].totalAllocations;
+        spdlog::debug("Host memory: {:.1f} allocations per frame ({:.1f} command scope), {} KiB live, peak {} KiB",
+            static_cast<double>(allocations - report[i].lastAllocations) / report[i].frames,
+            static_cast<double>(commandAllocations - report[i].lastCommandAllocations) / report[i].frames,
+            stats.total.bytes / 1024, stats.total.peakBytes / 1024);
+        report[i].frames = 0;
+        report[i].lastAllocations = allocations;
+        report[i].lastCommandAllocations = commandAllocations;
+    }
+}
+
+// GPU cost follows pixel count, so the side scale moves by the square root of the time ratio.
+// Steps are quantized and followed by a cooldown so the scale settles instead of hunting every frame.
+void adjustResolutionScale(DynamicResolution& resolution, float gpuMilliseconds)
+{
+    const float smoothing = 0.1f;
+    const float step = 1.0f / 32.0f;
+    const uint32_t settleFrames = 30;
+
+    if (resolution.gpuMilliseconds <= 0.0f)
+    {
+        resolution.gpuMilliseconds = gpuMilliseconds;
+    }
+    resolution.gpuMilliseconds += (gpuMilliseconds - resolution.gpuMilliseconds) * smoothing;
+    if (resolution.cooldown > 0)
+    {
+        resolution.cooldown--;
+        return;
+    }
+
+    float desired = resolution.scale * std::sqrt(resolution.targetMilliseconds / std::max(resolution.gpuMilliseconds, 0.01f));
+    desired = std::clamp(std::round(desired / step) * step, resolution.minScale, resolution.maxScale);
+    if (desired != resolution.scale)
+    {
+        resolution.scale = desired;
+        resolution.cooldown = settleFrames;
+    }
+}
+
+void BeginFrame(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd, SkiaGPU* skgpu)
+{
+    auto window = it.term<Window>(4);
+    auto resolution = it.term<DynamicResolution>(5);
+    vkWaitForFences(rd->logical, 1, &window->inFlightFence, VK_TRUE, UINT64_MAX);
+    vkResetFences(rd->logical, 1, &window->inFlightFence);
+
+    // The fence covers the previous frame, so its timestamps are ready without stalling
+    SceneTarget& target = window->sceneTarget;
+    if (target.timestampsWritten)
+    {
+        uint64_t timestamps[2];
+        if (vkGetQueryPoolResults(rd->logical, target.timestampPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            adjustResolutionScale(*resolution, static_cast<float>(timestamps[1] - timestamps[0]) * rd->timestampPeriod * 1e-6f);
+        }
+        target.timestampsWritten = false;
+    }
+
+    bool scaled = resolution->scaleScene && target.upscalePipeline != VK_NULL_HANDLE && target.textureSlot != NO_TEXTURE_SLOT;
+    VkExtent2D renderExtent = window->swapChainExtent;
+    if (scaled)
+    {
+        renderExtent.width = std::clamp(static_cast<uint32_t>(std::lround(window->swapChainExtent.width * resolution->scale)), 1u, target.allocatedExtent.width);
+        renderExtent.height = std::clamp(static_cast<uint32_t>(std::lround(window->swapChainExtent.height * resolution->scale)), 1u, target.allocatedExtent.height);
+    }
+    // Cached scene and upscale secondaries bake in the target and its extent
+    if (scaled != target.active || renderExtent.width != target.renderExtent.width || renderExtent.height != target.renderExtent.height)
+    {
+        target.active = scaled;
+        target.renderExtent = renderExtent;
+        window->sceneVersion++;
+    }
+
+    // The previous frame has retired, so Skia may free what it kept alive for its secondary command buffer
+    if (skgpu->retiredContext)
+    {
+        skgpu->retiredContext->releaseResources();
+        skgpu->retiredContext.reset();
+    }
+
+    vkAcquireNextImageKHR(rd->logical, window->swapChain, UINT64_MAX, window->imageAvailableSemaphore, VK_NULL_HANDLE, &window->imageIndex);
+
+    // The UI composites over the scene, so it can only share the scaled target when the scene uses it too
+    bool scaleUi = scaled && resolution->scaleUi;
+    VkExtent2D skiaExtent = scaleUi ? renderExtent : window->swapChainExtent;
+    VkRenderPass skiaRenderPass = scaleUi ? target.renderPass : window->renderPass;
+    VkFramebuffer skiaFramebuffer = scaleUi ? target.framebuffer : window->swapChainFramebuffers[window->imageIndex];
+
+    VkCommandBuffer commandBuffer = skgpu->commandBuffers[window->imageIndex];
+    beginSecondaryCommandBuffer(commandBuffer, skiaRenderPass, skiaFramebuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    skgpu->drawBounds.offset = {0, 0};
+    skgpu->drawBounds.extent = skiaExtent;
+    skgpu->imageInfo = skgpu->imageInfo.makeWH(skiaExtent.width, skiaExtent.height);
+    GrVkDrawableInfo drawableInfo{};
+    drawableInfo.fSecondaryCommandBuffer = commandBuffer;
+    drawableInfo.fColorAttachmentIndex = 0;
+    drawableInfo.fCompatibleRenderPass = skiaRenderPass;
+    drawableInfo.fFormat = window->swapChainImageFormat;
+    drawableInfo.fDrawBounds = &skgpu->drawBounds;
+    SkSurfaceProps surfaceProps;
+    skgpu->drawContext = GrVkSecondaryCBDrawContext::Make(skgpu->vkContext.get(), skgpu->imageInfo, drawableInfo, &surfaceProps);
+    if (!skgpu->drawContext)
+    {
+        // Leave the secondary empty and executable, RenderFrame skips it
+        spdlog::error("Failed to create Skia secondary command buffer draw context");
+        vkEndCommandBuffer(commandBuffer);
+        return;
+    }
+
+    // Skia draws in window units whatever the density of the target behind them
+    float canvasScale = window->contentScale * skiaExtent.width / window->swapChainExtent.width;
+    skgpu->drawContext->getCanvas()->scale(canvasScale, canvasScale);
+    skgpu->canvasScale = canvasScale;
+    skgpu->logicalSize = SkSize::Make(window->swapChainExtent.width / window->contentScale, window->swapChainExtent.height / window->contentScale);
+    if (!skgpu->drawContext->characterize(&skgpu->characterization))
+    {
+        spdlog::error("Failed to characterize the Skia draw context");
+    }
+}
+
+void recordGuideRing(SkCanvas* canvas, SkSize size)
+{
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    paint.setStyle(SkPaint::kStroke_Style);
+    paint.setStrokeWidth(1.0f);
+    paint.setColor(0xCC666666);
+    canvas->drawCircle(size.width() / 2.0f, size.height() / 2.0f, 128.0f, paint);
+}
+
+constexpr float MARKER_RADIUS = 3.0f;
+
+// One of several marker layers. Each takes every shards-th row of the cells in view, so large marker
+// sets are culled to the window and recorded in parallel. Round points draw them in one call.
+void recordMarkers(flecs::entity loop, uint32_t shard, uint32_t shards, SkCanvas* canvas, SkSize size)
+{
+    const MarkerIndex* index = loop.get<MarkerIndex>();
+    if (!index)
+    {
+        return;
+    }
+    std::vector<SkPoint> points;
+    glm::vec2 min(-MARKER_RADIUS);
+    glm::vec2 max(size.width() + MARKER_RADIUS, size.height() + MARKER_RADIUS);
+    visitMarkerCells(*index, min, max, shard, shards, [&](const std::vector<MarkerEntry>& entries) {
+        for (const auto& entry : entries)
+        {
+            points.push_back(SkPoint::Make(entry.position.x, entry.position.y));
+        }
+    });
+    if (points.empty())
+    {
+        return;
+    }
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    paint.setColor(0xCCE0E0E0);
+    paint.setStrokeCap(SkPaint::kRound_Cap);
+    paint.setStrokeWidth(MARKER_RADIUS * 2.0f);
+    canvas->drawPoints(SkCanvas::kPoints_PointMode, points.size(), points.data(), paint);
+}
+
+// Spiral indicator and the hovered marker or spiral sample, above the marker layers
+void recordLoopOverlay(flecs::entity loop, SkCanvas* canvas, SkSize size)
+{
+    const Hover* hover = loop.get<Hover>();
+    const SpiralIndicator* indicator = loop.get<SpiralIndicator>();
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    if (indicator)
+    {
+        paint.setColor(0xFF0F9D58);
+        canvas->drawCircle(indicator->position.x, indicator->position.y, 8.0f, paint);
+    }
+    if (hover && hover->marker)
+    {
+        const Marker* marker = flecs::entity(loop.world(), hover->marker).get<Marker>();
+        if (marker)
+        {
+            paint.setColor(0xFF0E5DE0);
+            paint.setStyle(SkPaint::kStroke_Style);
+            paint.setStrokeWidth(2.0f);
+            canvas->drawCircle(marker->position.x, marker->position.y, 6.0f, paint);
+        }
+    }
+    else if (hover && hover->onSpiral)
+    {
+        paint.setColor(0xFF0F9D58);
+        paint.setStyle(SkPaint::kStroke_Style);
+        paint.setStrokeWidth(2.0f);
+        canvas->drawCircle(hover->spiralPosition.x, hover->spiralPosition.y, 6.0f, paint);
+    }
+}
+
+// Records every layer in parallel, then replays the display lists on this thread in layer order
+void RecordSkiaLayers(flecs::iter& it, SkiaGPU* skgpu, SkiaLayers* layers)
+{
+    for (int i = 0; i < it.count(); i++)
+    {
+        if (!skgpu[i].drawContext || !skgpu[i].recorders || !skgpu[i].characterization.isValid())
+        {
+            continue;
+        }
+        auto& ordered = layers[i].ordered;
+        ordered.clear();
+        layers[i].layers.each([&](SkiaLayer& layer) {
+            if (layer.record)
+            {
+                ordered.push_back(&layer);
+            }
+        });
+        std::stable_sort(ordered.begin(), ordered.end(), [](const SkiaLayer* a, const SkiaLayer* b) { return a->order < b->order; });
+
+        recordSkiaLayers(*skgpu[i].recorders, ordered, skgpu[i].characterization, skgpu[i].canvasScale, skgpu[i].logicalSize);
+        // The draw context holds on to the display lists until its frame has retired
+        for (SkiaLayer* layer : ordered)
+        {
+            if (layer->displayList && !skgpu[i].drawContext->draw(std::move(layer->displayList)))
+            {
+                spdlog::error("Failed to replay a Skia layer");
+            }
+            layer->displayList.reset();
+        }
+    }
+}
+
+void DrawScripts(flecs::iter& it, const ScriptDraw* script)
+{
+    auto skgpu = it.term<const SkiaGPU>(2);
+    if (!skgpu->drawContext)
+    {
+        return;
+    }
+    SkCanvas* canvas = skgpu->drawContext->getCanvas();
+    for (int i = 0; i < it.count(); i++)
+    {
+        if (script[i].draw)
+        {
+            canvas->save();
+            script[i].draw(canvas, skgpu->logicalSize);
+            canvas->restore();
+        }
+    }
+}
+
+// Hands finished readbacks to the writer in frame order and takes back the slots it has written.
+// Fences are only polled, so a slow disk costs dropped frames, never frame time.
+void collectCapturedFrames(const RenderDevice* rd, FrameCapture& capture)
+{
+    std::vector<uint32_t> written;
+    takeWrittenSlots(*capture.writer, written);
+    for (uint32_t slot : written)
+    {
+        capture.slots[slot].state = CaptureSlotState::Free;
+    }
+
+    std::vector<CaptureJob> ready;
+    for (uint32_t slot = 0; slot < capture.slots.size(); slot++)
+    {
+        CaptureSlot& s = capture.slots[slot];
+        if (s.state == CaptureSlotState::InFlight && vkGetFenceStatus(rd->logical, s.fence) == VK_SUCCESS)
+        {
+            vkResetFences(rd->logical, 1, &s.fence);
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = s.buffer.memory;
+            range.size = VK_WHOLE_SIZE;
+            vkInvalidateMappedMemoryRanges(rd->logical, 1, &range);
+            s.state = CaptureSlotState::Writing;
+            ready.push_back({slot, s.frame, static_cast<const uint8_t*>(s.mapped)});
+        }
+    }
+    std::sort(ready.begin(), ready.end(), [](const CaptureJob& a, const CaptureJob& b) { return a.frame < b.frame; });
+    for (const auto& job : ready)
+    {
+        queueCaptureFrame(*capture.writer, job);
+    }
+}
+
+// Lossless captures block here until the writer frees a slot. The wait is added up so replays
+// can leave it out of their frame times.
+CaptureSlot* waitForCaptureSlot(const RenderDevice* rd, FrameCapture& capture)
+{
+    auto start = std::chrono::steady_clock::now();
+    while (true)
+    {
+        for (auto& slot : capture.slots)
+        {
+            if (slot.state == CaptureSlotState::InFlight)
+            {
+                vkWaitForFences(rd->logical, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            }
+        }
+        collectCapturedFrames(rd, capture);
+        for (auto& slot : capture.slots)
+        {
+            if (slot.state == CaptureSlotState::Free)
+            {
+                capture.stalledMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                return &slot;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void RenderFrame(flecs::iter& it, PlatformFramework* pf, RenderDevice* rd, SkiaGPU* skgpu)
+{
+    auto window = it.term<Window>(4);
+    auto resolution = it.term<const DynamicResolution>(5);
+    auto capture = it.term<FrameCapture>(6);
+    uint32_t imageIndex = window->imageIndex;
+
+    // Flush Skia's draws into its secondary command buffer, then submit any uploads it queued ahead of ours.
+    // Without a draw context (an unsupported swapchain format) the frame goes out without the UI.
+    bool skiaRecorded = skgpu->drawContext != nullptr;
+    if (skiaRecorded)
+    {
+        skgpu->drawContext->flush();
+        if (vkEndCommandBuffer(skgpu->commandBuffers[imageIndex]) != VK_SUCCESS)
+        {
+            spdlog::error("Failed to record Skia command buffer");
+            skiaRecorded = false;
+        }
+        skgpu->vkContext->submit();
+        skgpu->retiredContext = std::move(skgpu->drawContext);
+    }
+
+    auto recordStart = std::chrono::steady_clock::now();
+
+    // Curve geometry is generated on the compute queue, the graphics submit waits on it before vertex input
+    CurveCompute& curves = window->curves;
+    uint32_t curveVertexCount = 0;
+    for (const auto& dispatch : curves.dispatches)
+    {
+        curveVertexCount = std::max(curveVertexCount, dispatch.firstVertex + dispatch.count);
+    }
+    bool generateCurves = curves.pipeline != VK_NULL_HANDLE && curveVertexCount > 0;
+    if (!generateCurves)
+    {
+        curveVertexCount = 0;
+    }
+    if (curveVertexCount != curves.vertexCount)
+    {
+        curves.vertexCount = curveVertexCount;
+        window->sceneVersion++;
+    }
+    if (generateCurves)
+    {
+        recordCurveCommands(curves);
+        VkSubmitInfo computeSubmitInfo{};
+        computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        computeSubmitInfo.commandBufferCount = 1;
+        computeSubmitInfo.pCommandBuffers = &curves.commandBuffer;
+        computeSubmitInfo.signalSemaphoreCount = 1;
+        computeSubmitInfo.pSignalSemaphores = &curves.finishedSemaphore;
+        if (vkQueueSubmit(rd->computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            spdlog::error("Failed to submit curve command buffer");
+        }
+    }
+    curves.dispatches.clear();
+
+    SceneTarget& target = window->sceneTarget;
+    if (window->recordedVersions[imageIndex] != window->sceneVersion)
+    {
+        recordSceneCommandBuffer(window->sceneCommandBuffers[imageIndex], imageIndex, &*window, target.active);
+        if (target.active)
+        {
+            recordUpscaleCommandBuffer(target.upscaleCommandBuffers[imageIndex], imageIndex, &*window, resolution->sharpness);
+        }
+        window->recordedVersions[imageIndex] = window->sceneVersion;
+        window->frameTimings.recorded++;
+    }
+
+    // Scaled layers go to the scene target, the swapchain pass upscales it under the native layers
+    VkCommandBuffer scaled[2];
+    VkCommandBuffer native[3];
+    uint32_t scaledCount = 0;
+    uint32_t nativeCount = 0;
+    if (target.active)
+    {
+        scaled[scaledCount++] = window->sceneCommandBuffers[imageIndex];
+        native[nativeCount++] = target.upscaleCommandBuffers[imageIndex];
+    }
+    else
+    {
+        native[nativeCount++] = window->sceneCommandBuffers[imageIndex];
+    }
+    if (skiaRecorded && target.active && resolution->scaleUi)
+    {
+        scaled[scaledCount++] = skgpu->commandBuffers[imageIndex];
+    }
+    else if (skiaRecorded)
+    {
+        native[nativeCount++] = skgpu->commandBuffers[imageIndex];
+    }
+
+    // A full ring drops the frame instead of waiting on the disk
+    CaptureSlot* captureSlot = nullptr;
+    if (capture->writer)
+    {
+        for (auto& slot : capture->slots)
+        {
+            if (slot.state == CaptureSlotState::Free)
+            {
+                captureSlot = &slot;
+                break;
+            }
+        }
+        if (!captureSlot && capture->lossless)
+        {
+            captureSlot = waitForCaptureSlot(rd, *capture);
+        }
+        if (!captureSlot)
+        {
+            capture->dropped++;
+        }
+    }
+    recordCommandBuffer(window->commandBuffers[imageIndex], imageIndex, &*window, scaledCount, scaled, nativeCount, native,
+        captureSlot ? captureSlot->buffer.buffer : VK_NULL_HANDLE);
+    auto submitStart = std::chrono::steady_clock::now();
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    VkSemaphore waitSemaphores[] = {window->imageAvailableSemaphore, curves.finishedSemaphore};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
+    submitInfo.waitSemaphoreCount = generateCurves ? 2 : 1;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &window->commandBuffers[imageIndex];
+
+    VkSemaphore signalSemaphores[] = {window->renderFinishedSemaphore};
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    if (vkQueueSubmit(rd->graphicsQueue, 1, &submitInfo, window->inFlightFence) != VK_SUCCESS) {
+        spdlog::error("Failed to submit draw command buffer");
+    }
+    // An empty submit signals the slot's own fence once the frame and its copy are done,
+    // so the ring drains independently of the single in-flight fence
+    if (captureSlot)
+    {
+        captureSlot->frame = capture->frame;
+        captureSlot->state = CaptureSlotState::InFlight;
+        vkQueueSubmit(rd->graphicsQueue, 0, nullptr, captureSlot->fence);
+    }
+    capture->frame++;
+
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = signalSemaphores;
+
+    VkSwapchainKHR swapChains[] = {window->swapChain};
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = swapChains;
+    presentInfo.pImageIndices = &imageIndex;
+
+    vkQueuePresentKHR(rd->presentQueue, &presentInfo);
+
+    auto frameEnd = std::chrono::steady_clock::now();
+    FrameTimings& timings = window->frameTimings;
+    timings.recordSeconds += std::chrono::duration<double>(submitStart - recordStart).count();
+    timings.submitSeconds += std::chrono::duration<double>(frameEnd - submitStart).count();
+    if (++timings.frames == 600)
+    {
+        spdlog::debug("Frame CPU over {} frames: record {:.4f} ms, submit+present {:.4f} ms, scene re-recorded {}",
+            timings.frames, timings.recordSeconds * 1000.0 / timings.frames, timings.submitSeconds * 1000.0 / timings.frames, timings.recorded);
+        if (target.active)
+        {
+            spdlog::debug("Scene at {}x{} ({:.3f} scale), GPU {:.3f} ms", target.renderExtent.width, target.renderExtent.height,
+                resolution->scale, resolution->gpuMilliseconds);
+        }
+        timings = FrameTimings{};
+    }
+}
+
+void CollectCapturedFrames(flecs::iter& it, FrameCapture* capture)
+{
+    auto rd = it.term<const RenderDevice>(2);
+    for (int i = 0; i < it.count(); i++)
+    {
+        if (capture[i].writer)
+        {
+            collectCapturedFrames(rd, capture[i]);
+        }
+    }
+}
+
+// Expects the device to be idle: queues the remaining readbacks, flushes the writer and frees the ring
+void StopFrameCapture(const RenderDevice* rd, FrameCapture& capture)
+{
+    if (!capture.writer)
+    {
+        return;
+    }
+    collectCapturedFrames(rd, capture);
+    stopCaptureWriter(*capture.writer);
+    spdlog::info("Captured {} of {} frames to {}, {} dropped", capture.writer->framesWritten, capture.frame, capture.path, capture.dropped);
+    for (auto& slot : capture.slots)
+    {
+        vkUnmapMemory(rd->logical, slot.buffer.memory);
+        destroyBuffer(rd, slot.buffer);
+        vkDestroyFence(rd->logical, slot.fence, vkAllocator(VK_OBJECT_TYPE_FENCE));
+    }
+    capture.slots.clear();
+    capture.writer.reset();
+}
+
+// Runs the simulation systems in fixed ticks. Backlog past maxTicksPerFrame is dropped, so a
+// stalled frame slows playback once instead of spiralling into ever longer frames.
+void StepSimulation(flecs::iter& it, SimulationClock* clock)
+{
+    for (int i = 0; i < it.count(); i++)
+    {
+        SimulationClock& c = clock[i];
+        c.accumulator += it.delta_time();
+        double step = c.tickSeconds * c.playRate;
+        uint32_t ticks = 0;
+        while (c.accumulator >= c.tickSeconds && ticks < c.maxTicksPerFrame)
+        {
+            for (auto system : c.systems)
+            {
+                ecs_run(it.world().c_ptr(), system, static_cast<FLECS_FLOAT>(step), nullptr);
+            }
+            c.accumulator -= c.tickSeconds;
+            c.time += step;
+            c.tick++;
+            ticks++;
+        }
+        if (c.accumulator >= c.tickSeconds)
+        {
+            c.accumulator = std::fmod(c.accumulator, c.tickSeconds);
+        }
+        c.alpha = static_cast<float>(c.accumulator / c.tickSeconds);
+    }
+}
+
+// Simulation system, it.delta_time() is the fixed tick already scaled by the clock's play rate,
+// the loop's own rate only multiplies on top of it.
+void AdvanceLoop(flecs::iter& it, LoopState* loop)
+{
+    for (int i = 0; i < it.count(); i++)
+    {
+        loop[i].previousProgress = loop[i].progress;
+        loop[i].progress += it.delta_time() * loop[i].playRate;
+    }
+}
+
+float interpolatedProgress(const LoopState& loop, float alpha)
+{
+    return loop.previousProgress + (loop.progress - loop.previousProgress) * alpha;
+}
+
+// Queues one compute dispatch per spiral, packed back to back in the curve vertex buffer
+void CollectCurves(flecs::iter& it, const LogSpiral* spiral, const LoopState* loop)
+{
+    auto window = it.term<Window>(3);
+    auto clock = it.term<const SimulationClock>(4);
+    CurveCompute& curves = window->curves;
+    for (int i = 0; i < it.count(); i++)
+    {
+        uint32_t firstVertex = curves.dispatches.empty() ? 0 : curves.dispatches.back().firstVertex + curves.dispatches.back().count;
+        if (firstVertex + spiral[i].count > MAX_CURVE_VERTICES)
+        {
+            spdlog::error("Curve vertex buffer full, skipping curve of entity {}", it.entity(i).id());
+            continue;
+        }
+        CurvePushConstants dispatch{};
+        dispatch.center = spiral[i].center;
+        dispatch.a = spiral[i].a;
+        dispatch.k = spiral[i].k;
+        dispatch.phiStart = spiral[i].phiStart;
+        dispatch.phiStep = spiral[i].phiStep;
+        dispatch.playRate = loop[i].playRate * clock->playRate;
+        dispatch.rotation = spiralAngle(spiral[i], interpolatedProgress(loop[i], clock->alpha));
+        dispatch.width = 1.0f;
+        dispatch.color = packLineColor(0x22666666);
+        dispatch.count = spiral[i].count;
+        dispatch.firstVertex = firstVertex;
+        curves.dispatches.push_back(dispatch);
+    }
+}
+
+void UploadPolylines(const RenderDevice* rd, Window& window, flecs::query<const Polyline>& polylines)
+{
+    std::vector<LineVertex> vertices;
+    polylines.each([&](const Polyline& polyline) {
+        if (polyline.vertices.empty())
+        {
+            return;
+        }
+        // A zero width vertex between polylines keeps the instanced segments from bridging them
+        if (!vertices.empty())
+        {
+            vertices.back().width = 0.0f;
+        }
+        vertices.insert(vertices.end(), polyline.vertices.begin(), polyline.vertices.end());
+    });
+
+    window.lineVertexCount = static_cast<uint32_t>(vertices.size());
+    if (vertices.empty())
+    {
+        return;
+    }
+    VkDeviceSize size = sizeof(LineVertex) * vertices.size();
+    if (window.lineVertices.size < size)
+    {
+        if (window.lineVertices.buffer != VK_NULL_HANDLE)
+        {
+            destroyBuffer(rd, window.lineVertices);
+        }
+        createBuffer(rd, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, window.lineVertices);
+    }
+    uploadBuffer(rd, window.commandPool, window.lineVertices, vertices.data(), size);
+}
+
+// Runs after BeginFrame has waited on the in-flight fence, so scene buffers may be rewritten here
+void TrackSceneChanges(flecs::iter& it, Window* window, SceneChanges* changes)
+{
+    auto rd = it.term<const RenderDevice>(3);
+    for (int i = 0; i < it.count(); i++)
+    {
+        bool changed = false;
+        if (changes[i].drawables.changed())
+        {
+            window[i].drawables.clear();
+            changes[i].drawables.each([&](const Drawable& drawable) {
+                window[i].drawables.push_back(drawable);
+            });
+            changed = true;
+        }
+        if (changes[i].polylines.changed())
+        {
+            UploadPolylines(rd, window[i], changes[i].polylines);
+            changed = true;
+        }
+        if (changed)
+        {
+            window[i].sceneVersion++;
+        }
+    }
+}
+
+void CreateWindowSurface(flecs::iter& it, Window* window)
+{
+    auto pf = it.term<const PlatformFramework>(2);
+    auto rd = it.term<const RenderDevice>(3);
+    spdlog::info("Create window surface");
+    VkResult result;
+    if ((result = glfwCreateWindowSurface(pf->instance, window->object, vkAllocator(VK_OBJECT_TYPE_SURFACE_KHR), &window->surface)) != VK_SUCCESS)
+    {
+        spdlog::error("Failed to create window surface {}", result);
+    }
+
+}
+
+void DestroyWindowSurface(flecs::iter it, Window* window)
+{
     auto pf = it.term<const PlatformFramework>(2);
     auto rd = it.term<const RenderDevice>(3);
+    auto skgpu = it.term<SkiaGPU>(4);
+    auto capture = it.term<FrameCapture>(5);
     vkDeviceWaitIdle(rd->logical);
-    vkDestroySemaphore(rd->logical, window->imageAvailableSemaphore, nullptr);
-    vkDestroySemaphore(rd->logical, window->renderFinishedSemaphore, nullptr);
-    vkDestroyFence(rd->logical, window->inFlightFence, nullptr);
-    vkDestroyCommandPool(rd->logical, window->commandPool, nullptr);
+    StopFrameCapture(rd, *capture);
+    if (skgpu->recorders)
+    {
+        stopSkiaRecorders(*skgpu->recorders);
+    }
+    if (skgpu->retiredContext)
+    {
+        skgpu->retiredContext->releaseResources();
+        skgpu->retiredContext.reset();
+    }
+    skgpu->vkContext->releaseResourcesAndAbandonContext();
+    skgpu->vkContext.reset();
+    vkDestroySemaphore(rd->logical, window->imageAvailableSemaphore, vkAllocator(VK_OBJECT_TYPE_SEMAPHORE));
+    vkDestroySemaphore(rd->logical, window->renderFinishedSemaphore, vkAllocator(VK_OBJECT_TYPE_SEMAPHORE));
+    vkDestroyFence(rd->logical, window->inFlightFence, vkAllocator(VK_OBJECT_TYPE_FENCE));
+    vkDestroyCommandPool(rd->logical, window->commandPool, vkAllocator(VK_OBJECT_TYPE_COMMAND_POOL));
     for (auto framebuffer : window->swapChainFramebuffers) {
-        vkDestroyFramebuffer(rd->logical, framebuffer, nullptr);
+        vkDestroyFramebuffer(rd->logical, framebuffer, vkAllocator(VK_OBJECT_TYPE_FRAMEBUFFER));
     }
     for (auto imageView : window->swapChainImageViews)
     {
-        vkDestroyImageView(rd->logical, imageView, nullptr);
+        vkDestroyImageView(rd->logical, imageView, vkAllocator(VK_OBJECT_TYPE_IMAGE_VIEW));
+    }
+    if (window->lineVertices.buffer != VK_NULL_HANDLE)
+    {
+        destroyBuffer(rd, window->lineVertices);
+    }
+    SceneTarget& target = window->sceneTarget;
+    if (target.timestampPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(rd->logical, target.timestampPool, vkAllocator(VK_OBJECT_TYPE_QUERY_POOL));
+    }
+    vkDestroyPipeline(rd->logical, target.upscalePipeline, vkAllocator(VK_OBJECT_TYPE_PIPELINE));
+    vkDestroyPipelineLayout(rd->logical, target.upscalePipelineLayout, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+    vkDestroyFramebuffer(rd->logical, target.framebuffer, vkAllocator(VK_OBJECT_TYPE_FRAMEBUFFER));
+    vkDestroyImageView(rd->logical, target.view, vkAllocator(VK_OBJECT_TYPE_IMAGE_VIEW));
+    vkDestroyImage(rd->logical, target.image, vkAllocator(VK_OBJECT_TYPE_IMAGE));
+    vkFreeMemory(rd->logical, target.memory, vkAllocator(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    vkDestroyRenderPass(rd->logical, target.renderPass, vkAllocator(VK_OBJECT_TYPE_RENDER_PASS));
+    CurveCompute& curves = window->curves;
+    destroyBuffer(rd, curves.vertices);
+    vkDestroySemaphore(rd->logical, curves.finishedSemaphore, vkAllocator(VK_OBJECT_TYPE_SEMAPHORE));
+    vkDestroyCommandPool(rd->logical, curves.commandPool, vkAllocator(VK_OBJECT_TYPE_COMMAND_POOL));
+    vkDestroyPipeline(rd->logical, curves.pipeline, vkAllocator(VK_OBJECT_TYPE_PIPELINE));
+    vkDestroyPipelineLayout(rd->logical, curves.pipelineLayout, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+    vkDestroyDescriptorPool(rd->logical, curves.descriptorPool, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+    vkDestroyDescriptorSetLayout(rd->logical, curves.setLayout, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+    vkDestroyPipeline(rd->logical, window->linePipeline, vkAllocator(VK_OBJECT_TYPE_PIPELINE));
+    vkDestroyPipelineLayout(rd->logical, window->linePipelineLayout, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+    vkDestroyPipeline(rd->logical, window->graphicsPipeline, vkAllocator(VK_OBJECT_TYPE_PIPELINE));
+    vkDestroyPipelineLayout(rd->logical, window->pipelineLayout, vkAllocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+    vkDestroyDescriptorPool(rd->logical, window->bindlessPool, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+    vkDestroyDescriptorSetLayout(rd->logical, window->bindlessLayout, vkAllocator(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+    vkDestroySampler(rd->logical, window->bindlessSampler, vkAllocator(VK_OBJECT_TYPE_SAMPLER));
+    vkDestroyRenderPass(rd->logical, window->renderPass, vkAllocator(VK_OBJECT_TYPE_RENDER_PASS));
+    vkDestroySwapchainKHR(rd->logical, window->swapChain, vkAllocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
+    vkDestroySurfaceKHR(pf->instance, window->surface, vkAllocator(VK_OBJECT_TYPE_SURFACE_KHR));
+}
+
+void IndexMarker(flecs::iter& it, const Marker* marker)
+{
+    auto index = it.term<MarkerIndex>(2);
+    for (int i = 0; i < it.count(); i++)
+    {
+        insertMarker(*index, it.entity(i).id(), marker[i].position);
     }
-    vkDestroyPipeline(rd->logical, window->graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(rd->logical, window->pipelineLayout, nullptr);
-    vkDestroyRenderPass(rd->logical, window->renderPass, nullptr);
-    vkDestroySwapchainKHR(rd->logical, window->swapChain, nullptr);
-    vkDestroySurfaceKHR(pf->instance, window->surface, nullptr);
-}
\ No newline at end of file
+}
+
+void UnindexMarker(flecs::iter& it, const Marker* marker)
+{
+    auto index = it.term<MarkerIndex>(2);
+    for (int i = 0; i < it.count(); i++)
+    {
+        removeMarker(*index, it.entity(i).id());
+    }
+}
+
+// Markers created since the last save can be appended, anything else forces a full marker section
+void TrackAddedMarkers(flecs::iter& it, const Marker* marker)
+{
+    auto snapshot = it.term<ProjectSnapshot>(2);
+    for (int i = 0; i < it.count(); i++)
+    {
+        snapshot->addedMarkers.insert(it.entity(i).id());
+    }
+}
+
+void TrackChangedMarkers(flecs::iter& it, const Marker* marker)
+{
+    auto snapshot = it.term<ProjectSnapshot>(2);
+    for (int i = 0; i < it.count(); i++)
+    {
+        if (!snapshot->addedMarkers.count(it.entity(i).id()))
+        {
+            snapshot->rewriteMarkers = true;
+        }
+    }
+}
+
+void TrackRemovedMarkers(flecs::iter& it, const Marker* marker)
+{
+    auto snapshot = it.term<ProjectSnapshot>(2);
+    for (int i = 0; i < it.count(); i++)
+    {
+        if (!snapshot->addedMarkers.erase(it.entity(i).id()))
+        {
+            snapshot->rewriteMarkers = true;
+        }
+    }
+}
+
+// Ctrl+S saves the project
+void SaveProject(flecs::iter& it, ProjectSnapshot* snapshot)
+{
+    auto input = it.term<const InputState>(2);
+    if (keyPressed(*input, GLFW_KEY_S, GLFW_MOD_CONTROL))
+    {
+        for (int i = 0; i < it.count(); i++)
+        {
+            saveSnapshot(it.entity(i), snapshot[i]);
+        }
+    }
+}
+
+// Only requests the step, stepEditor applies it after progress so its writes aren't deferred
+void UndoRedo(flecs::iter& it, EditHistory* history)
+{
+    auto input = it.term<const InputState>(2);
+    for (int i = 0; i < it.count(); i++)
+    {
+        // Ctrl+Z also matches with shift held, so redo has to be checked first
+        if (keyPressed(*input, GLFW_KEY_Z, GLFW_MOD_CONTROL | GLFW_MOD_SHIFT) || keyPressed(*input, GLFW_KEY_Y, GLFW_MOD_CONTROL))
+        {
+            history[i].requested = HistoryRequest::Redo;
+        }
+        else if (keyPressed(*input, GLFW_KEY_Z, GLFW_MOD_CONTROL))
+        {
+            history[i].requested = HistoryRequest::Undo;
+        }
+    }
+}
+
+// Runs after every other system has merged its changes, so a frame's edits end up in one step
+void CommitHistory(flecs::iter& it, EditHistory* history)
+{
+    for (int i = 0; i < it.count(); i++)
+    {
+        commitHistory(history[i]);
+    }
+}
+
+// Follows the spiral as the curve pass draws it this frame
+void UpdateSpiralIndicator(flecs::iter& it, const LogSpiral* spiral, const LoopState* loop, SpiralIndicator* indicator)
+{
+    auto clock = it.term<const SimulationClock>(4);
+    for (int i = 0; i < it.count(); i++)
+    {
+        LogSpiral posed = posedSpiral(spiral[i], interpolatedProgress(loop[i], clock->alpha));
+        indicator[i].index = spiralIndexAtRadius(posed, indicator[i].radius);
+        indicator[i].position = spiralPoint(posed, indicator[i].index);
+    }
+}
+
+void HoverMarkers(flecs::iter& it, const MarkerIndex* index, Hover* hover)
+{
+    auto input = it.term<const InputState>(3);
+    for (int i = 0; i < it.count(); i++)
+    {
+        hover[i].marker = nearestMarker(index[i], input->cursor, hover[i].radius);
+    }
+}
+
+// Markers sit on top of the spiral, so the spiral is only picked where none is in reach
+void HoverSpiral(flecs::iter& it, const LogSpiral* spiral, const LoopState* loop, Hover* hover)
+{
+    auto clock = it.term<const SimulationClock>(4);
+    auto input = it.term<const InputState>(5);
+    for (int i = 0; i < it.count(); i++)
+    {
+        hover[i].onSpiral = false;
+        if (hover[i].marker || spiral[i].count == 0)
+        {
+            continue;
+        }
+        LogSpiral posed = posedSpiral(spiral[i], interpolatedProgress(loop[i], clock->alpha));
+        uint32_t index = spiralIndexNearest(posed, input->cursor);
+        if (spiralDistance2(posed, index, input->cursor) <= hover[i].radius * hover[i].radius)
+        {
+            hover[i].onSpiral = true;
+            hover[i].spiralIndex = index;
+            hover[i].spiralPosition = spiralPoint(posed, index);
+        }
+    }
+}
@@ -0,0 +1,414 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+// Host memory the driver allocates through our VkAllocationCallbacks
+struct HostMemoryUsage
+{
+    int64_t bytes = 0;
+    int64_t peakBytes = 0;
+    int64_t allocations = 0;
+    int64_t peakAllocations = 0;
+    uint64_t totalAllocations = 0;
+};
+
+constexpr uint32_t HOST_SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+// Core object types map to themselves, the extension types we create get the slots after them
+constexpr uint32_t HOST_TYPE_SURFACE = VK_OBJECT_TYPE_COMMAND_POOL + 1;
+constexpr uint32_t HOST_TYPE_SWAPCHAIN = VK_OBJECT_TYPE_COMMAND_POOL + 2;
+constexpr uint32_t HOST_TYPE_DEBUG_MESSENGER = VK_OBJECT_TYPE_COMMAND_POOL + 3;
+constexpr uint32_t HOST_TYPE_OTHER = VK_OBJECT_TYPE_COMMAND_POOL + 4;
+constexpr uint32_t HOST_TYPE_COUNT = HOST_TYPE_OTHER + 1;
+
+// Locked adds on every counter cost several times more than the pooled allocation itself, so only
+// the live byte total is shared, which keeps its peak exact. Everything else is counted per thread:
+// each shard is written by its own thread alone and summed when read. Frees on another thread can
+// leave a shard negative, the sums are still exact. Those peaks are sampled whenever the stats are
+// read, once a frame.
+struct HostMemoryCount
+{
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> allocations{0};
+    std::atomic<uint64_t> totalAllocations{0};
+};
+
+struct HostMemoryShard
+{
+    HostMemoryCount total;
+    HostMemoryCount scopes[HOST_SCOPE_COUNT];
+    HostMemoryCount types[HOST_TYPE_COUNT];
+};
+
+struct HostMemoryStats
+{
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> peakBytes{0};
+    // Chunks reserved for the pools, they are never given back
+    std::atomic<int64_t> arenaBytes{0};
+    // Driver allocations it only tells us about (pfnInternalAllocation), not served by us
+    std::atomic<int64_t> internalBytes{0};
+
+    std::mutex shardMutex;
+    std::vector<HostMemoryShard*> shards;
+    // Sums of the shards as of the last sampleHostMemory
+    HostMemoryUsage total;
+    HostMemoryUsage scopes[HOST_SCOPE_COUNT];
+    HostMemoryUsage types[HOST_TYPE_COUNT];
+};
+
+HostMemoryStats& hostMemoryStats()
+{
+    static HostMemoryStats stats;
+    return stats;
+}
+
+// Shards outlive their threads, memory they counted may still be freed elsewhere
+HostMemoryShard& hostMemoryShard()
+{
+    thread_local HostMemoryShard* shard = [] {
+        auto created = new HostMemoryShard();
+        HostMemoryStats& stats = hostMemoryStats();
+        std::lock_guard<std::mutex> lock(stats.shardMutex);
+        stats.shards.push_back(created);
+        return created;
+    }();
+    return *shard;
+}
+
+void raisePeak(std::atomic<int64_t>& peak, int64_t value)
+{
+    int64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+// Only the owning thread writes a shard, a plain load and store is enough
+void addToShard(std::atomic<int64_t>& value, int64_t change)
+{
+    value.store(value.load(std::memory_order_relaxed) + change, std::memory_order_relaxed);
+}
+
+void countHostAllocation(uint32_t scope, uint32_t type, int64_t size)
+{
+    HostMemoryStats& stats = hostMemoryStats();
+    raisePeak(stats.peakBytes, stats.bytes.fetch_add(size, std::memory_order_relaxed) + size);
+
+    HostMemoryShard& shard = hostMemoryShard();
+    for (HostMemoryCount* count : {&shard.total, &shard.scopes[scope], &shard.types[type]})
+    {
+        addToShard(count->bytes, size);
+        addToShard(count->allocations, 1);
+        count->totalAllocations.store(count->totalAllocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+void countHostResize(uint32_t scope, uint32_t type, int64_t change)
+{
+    HostMemoryStats& stats = hostMemoryStats();
+    raisePeak(stats.peakBytes, stats.bytes.fetch_add(change, std::memory_order_relaxed) + change);
+    HostMemoryShard& shard = hostMemoryShard();
+    addToShard(shard.total.bytes, change);
+    addToShard(shard.scopes[scope].bytes, change);
+    addToShard(shard.types[type].bytes, change);
+}
+
+void countHostFree(uint32_t scope, uint32_t type, int64_t size)
+{
+    HostMemoryStats& stats = hostMemoryStats();
+    stats.bytes.fetch_sub(size, std::memory_order_relaxed);
+    HostMemoryShard& shard = hostMemoryShard();
+    for (HostMemoryCount* count : {&shard.total, &shard.scopes[scope], &shard.types[type]})
+    {
+        addToShard(count->bytes, -size);
+        addToShard(count->allocations, -1);
+    }
+}
+
+// Sums the shards into stats.total, stats.scopes and stats.types and raises their peaks
+void sampleHostMemory()
+{
+    HostMemoryStats& stats = hostMemoryStats();
+    std::lock_guard<std::mutex> lock(stats.shardMutex);
+    auto sample = [&](HostMemoryUsage& usage, auto count) {
+        usage.bytes = 0;
+        usage.allocations = 0;
+        usage.totalAllocations = 0;
+        for (HostMemoryShard* shard : stats.shards)
+        {
+            const HostMemoryCount& counted = count(*shard);
+            usage.bytes += counted.bytes.load(std::memory_order_relaxed);
+            usage.allocations += counted.allocations.load(std::memory_order_relaxed);
+            usage.totalAllocations += counted.totalAllocations.load(std::memory_order_relaxed);
+        }
+        usage.peakBytes = std::max(usage.peakBytes, usage.bytes);
+        usage.peakAllocations = std::max(usage.peakAllocations, usage.allocations);
+    };
+    sample(stats.total, [](const HostMemoryShard& shard) -> const HostMemoryCount& { return shard.total; });
+    stats.total.peakBytes = stats.peakBytes.load(std::memory_order_relaxed);
+    for (uint32_t scope = 0; scope < HOST_SCOPE_COUNT; scope++)
+    {
+        sample(stats.scopes[scope], [&](const HostMemoryShard& shard) -> const HostMemoryCount& { return shard.scopes[scope]; });
+    }
+    for (uint32_t type = 0; type < HOST_TYPE_COUNT; type++)
+    {
+        sample(stats.types[type], [&](const HostMemoryShard& shard) -> const HostMemoryCount& { return shard.types[type]; });
+    }
+}
+
+const char* hostScopeName(uint32_t scope)
+{
+    static const char* names[HOST_SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+    return names[scope];
+}
+
+const char* hostTypeName(uint32_t slot)
+{
+    static const char* names[HOST_TYPE_COUNT] = {
+        "unknown", "instance", "physical device", "device", "queue", "semaphore", "command buffer", "fence",
+        "device memory", "buffer", "image", "event", "query pool", "buffer view", "image view", "shader module",
+        "pipeline cache", "pipeline layout", "render pass", "pipeline", "descriptor set layout", "sampler",
+        "descriptor pool", "descriptor set", "framebuffer", "command pool", "surface", "swapchain",
+        "debug messenger", "other"};
+    return names[slot];
+}
+
+uint32_t hostTypeSlot(VkObjectType type)
+{
+    if (type <= VK_OBJECT_TYPE_COMMAND_POOL)
+    {
+        return static_cast<uint32_t>(type);
+    }
+    switch (type)
+    {
+    case VK_OBJECT_TYPE_SURFACE_KHR:
+        return HOST_TYPE_SURFACE;
+    case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+        return HOST_TYPE_SWAPCHAIN;
+    case VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT:
+        return HOST_TYPE_DEBUG_MESSENGER;
+    default:
+        return HOST_TYPE_OTHER;
+    }
+}
+
+// Sits right in front of every pointer handed to the driver
+struct HostAllocationHeader
+{
+    uint64_t size;
+    // From the start of the block to the pointer the driver got
+    uint32_t offset;
+    uint8_t scope;
+    uint8_t type;
+    uint8_t sizeClass;
+};
+
+// Command and object scope allocations are small and short lived, they come from per-thread free
+// lists of power of two blocks instead of malloc. Blocks freed on another thread join that thread's
+// lists, which is why arena chunks are never released.
+constexpr uint32_t HOST_POOL_MIN_BLOCK = 64;
+constexpr uint32_t HOST_POOL_CLASSES = 7;
+constexpr uint32_t HOST_POOL_CHUNK = 64 * 1024;
+constexpr uint8_t HOST_MALLOC_CLASS = UINT8_MAX;
+
+struct HostPool
+{
+    void* free[HOST_POOL_CLASSES] = {};
+};
+
+thread_local HostPool hostPool;
+
+uint32_t hostBlockSize(uint32_t sizeClass)
+{
+    return HOST_POOL_MIN_BLOCK << sizeClass;
+}
+
+void* takeHostBlock(uint32_t sizeClass)
+{
+    void*& head = hostPool.free[sizeClass];
+    if (!head)
+    {
+        // Carve a fresh chunk into blocks of this class
+        char* chunk = static_cast<char*>(std::aligned_alloc(HOST_POOL_MIN_BLOCK, HOST_POOL_CHUNK));
+        if (!chunk)
+        {
+            return nullptr;
+        }
+        hostMemoryStats().arenaBytes.fetch_add(HOST_POOL_CHUNK, std::memory_order_relaxed);
+        uint32_t blockSize = hostBlockSize(sizeClass);
+        for (uint32_t offset = HOST_POOL_CHUNK; offset >= blockSize; offset -= blockSize)
+        {
+            void* block = chunk + offset - blockSize;
+            *static_cast<void**>(block) = head;
+            head = block;
+        }
+    }
+    void* block = head;
+    head = *static_cast<void**>(block);
+    return block;
+}
+
+void giveHostBlock(void* block, uint32_t sizeClass)
+{
+    *static_cast<void**>(block) = hostPool.free[sizeClass];
+    hostPool.free[sizeClass] = block;
+}
+
+HostAllocationHeader* hostHeader(void* memory)
+{
+    return reinterpret_cast<HostAllocationHeader*>(static_cast<char*>(memory) - sizeof(HostAllocationHeader));
+}
+
+void* VKAPI_CALL hostAllocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (size == 0)
+    {
+        return nullptr;
+    }
+    // Room for the header in front and enough slack to align the pointer after it
+    size_t needed = sizeof(HostAllocationHeader) + (alignment - 1) + size;
+    uint8_t sizeClass = HOST_MALLOC_CLASS;
+    if ((scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND || scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) &&
+        alignment <= HOST_POOL_MIN_BLOCK && needed <= hostBlockSize(HOST_POOL_CLASSES - 1))
+    {
+        sizeClass = 0;
+        while (hostBlockSize(sizeClass) < needed)
+        {
+            sizeClass++;
+        }
+    }
+    char* block = static_cast<char*>(sizeClass == HOST_MALLOC_CLASS ? std::malloc(needed) : takeHostBlock(sizeClass));
+    if (!block)
+    {
+        return nullptr;
+    }
+
+    uintptr_t start = reinterpret_cast<uintptr_t>(block) + sizeof(HostAllocationHeader);
+    char* memory = reinterpret_cast<char*>((start + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+    HostAllocationHeader* header = hostHeader(memory);
+    header->type = static_cast<uint8_t>(reinterpret_cast<uintptr_t>(userData));
+    header->size = size;
+    header->offset = static_cast<uint32_t>(memory - block);
+    header->scope = static_cast<uint8_t>(scope);
+    header->sizeClass = sizeClass;
+
+    countHostAllocation(scope, header->type, size);
+    return memory;
+}
+
+void VKAPI_CALL hostFree(void* userData, void* memory)
+{
+    if (!memory)
+    {
+        return;
+    }
+    HostAllocationHeader* header = hostHeader(memory);
+    countHostFree(header->scope, header->type, static_cast<int64_t>(header->size));
+
+    char* block = static_cast<char*>(memory) - header->offset;
+    if (header->sizeClass == HOST_MALLOC_CLASS)
+    {
+        std::free(block);
+    }
+    else
+    {
+        giveHostBlock(block, header->sizeClass);
+    }
+}
+
+void* VKAPI_CALL hostReallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (!original)
+    {
+        return hostAllocate(userData, size, alignment, scope);
+    }
+    if (size == 0)
+    {
+        hostFree(userData, original);
+        return nullptr;
+    }
+    HostAllocationHeader* header = hostHeader(original);
+    // Pool blocks usually have room to grow in place
+    bool aligned = (reinterpret_cast<uintptr_t>(original) & (alignment - 1)) == 0;
+    if (header->sizeClass != HOST_MALLOC_CLASS && aligned && header->scope == scope &&
+        header->offset + size <= hostBlockSize(header->sizeClass))
+    {
+        countHostResize(scope, header->type, static_cast<int64_t>(size) - static_cast<int64_t>(header->size));
+        header->size = size;
+        return original;
+    }
+    void* memory = hostAllocate(userData, size, alignment, scope);
+    if (memory)
+    {
+        memcpy(memory, original, std::min<size_t>(size, header->size));
+        hostFree(userData, original);
+    }
+    return memory;
+}
+
+void VKAPI_CALL hostInternalAllocation(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+    hostMemoryStats().internalBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+void VKAPI_CALL hostInternalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+    hostMemoryStats().internalBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+// Allocation callbacks to pass to every create and destroy call. Each object type gets its own
+// copy so the driver's host memory can be broken down by the kind of object that caused it.
+// Destroy calls must use the same type as the matching create.
+const VkAllocationCallbacks* vkAllocator(VkObjectType type)
+{
+    static VkAllocationCallbacks* callbacks = [] {
+        static VkAllocationCallbacks table[HOST_TYPE_COUNT];
+        for (uint32_t slot = 0; slot < HOST_TYPE_COUNT; slot++)
+        {
+            table[slot].pUserData = reinterpret_cast<void*>(static_cast<uintptr_t>(slot));
+            table[slot].pfnAllocation = hostAllocate;
+            table[slot].pfnReallocation = hostReallocate;
+            table[slot].pfnFree = hostFree;
+            table[slot].pfnInternalAllocation = hostInternalAllocation;
+            table[slot].pfnInternalFree = hostInternalFree;
+        }
+        return table;
+    }();
+    return &callbacks[hostTypeSlot(type)];
+}
+
+void logHostMemory(const char* when)
+{
+    sampleHostMemory();
+    HostMemoryStats& stats = hostMemoryStats();
+    spdlog::info("Host memory {}: {} KiB live in {} allocations, peak {} KiB, {} allocations total, {} KiB pooled",
+        when, stats.total.bytes / 1024, stats.total.allocations, stats.total.peakBytes / 1024,
+        stats.total.totalAllocations, stats.arenaBytes.load() / 1024);
+    auto log = [](const char* name, const HostMemoryUsage& usage) {
+        if (usage.totalAllocations > 0)
+        {
+            spdlog::info("  {}: {} B live in {} allocations, peak {} B, {} allocations total",
+                name, usage.bytes, usage.allocations, usage.peakBytes, usage.totalAllocations);
+        }
+    };
+    for (uint32_t scope = 0; scope < HOST_SCOPE_COUNT; scope++)
+    {
+        log(hostScopeName(scope), stats.scopes[scope]);
+    }
+    for (uint32_t slot = 0; slot < HOST_TYPE_COUNT; slot++)
+    {
+        log(hostTypeName(slot), stats.types[slot]);
+    }
+    if (stats.internalBytes.load() != 0)
+    {
+        spdlog::info("  driver internal: {} B live", stats.internalBytes.load());
+    }
+}
@@ -2,7 +2,9 @@
 
 #include "vulkan/vulkan.h"
 #include <fstream>
+#include <cstring>
 #include <spdlog/spdlog.h>
+#include "vkalloc.h"
 
 PFN_vkVoidFunction getProc(const char* proc_name, VkInstance instance, VkDevice device)
 {
@@ -46,6 +48,87 @@ bool checkDeviceExtensionSupport(PlatformFramework* pf, VkPhysicalDevice device)
     return requiredExtensions.empty();
 }
 
+// Fills the window's surface capabilities, formats and present modes for this device
+VkBool32 querySurfaceSupport(VkPhysicalDevice device, Window* window)
+{
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, window->surface, &window->capabilities);
+    uint32_t formatCount;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, window->surface, &formatCount, nullptr);
+    window->formats.resize(formatCount);
+    if (formatCount != 0)
+    {
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, window->surface, &formatCount, window->formats.data());
+    }
+
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, window->surface, &presentModeCount, nullptr);
+    window->presentModes.resize(presentModeCount);
+    if (presentModeCount != 0) {
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, window->surface, &presentModeCount, window->presentModes.data());
+    }
+    return !window->formats.empty() && !window->presentModes.empty();
+}
+
+VkBool32 checkDescriptorIndexingSupport(VkPhysicalDevice device)
+{
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+
+    return indexingFeatures.runtimeDescriptorArray &&
+        indexingFeatures.descriptorBindingPartiallyBound &&
+        indexingFeatures.descriptorBindingVariableDescriptorCount &&
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+}
+
+// Returns NO_TEXTURE_SLOT when the table is full
+uint32_t allocateTextureSlot(TextureSlots& slots)
+{
+    if (!slots.freed.empty())
+    {
+        uint32_t slot = slots.freed.back();
+        slots.freed.pop_back();
+        return slot;
+    }
+    if (slots.next < slots.capacity)
+    {
+        return slots.next++;
+    }
+    spdlog::error("Bindless texture table is full ({} slots)", slots.capacity);
+    return NO_TEXTURE_SLOT;
+}
+
+// Only release a slot once no in-flight command buffer samples it
+void releaseTextureSlot(TextureSlots& slots, uint32_t slot)
+{
+    if (slot != NO_TEXTURE_SLOT)
+    {
+        slots.freed.push_back(slot);
+    }
+}
+
+void writeTextureSlot(VkDevice device, VkDescriptorSet set, uint32_t slot, VkImageView imageView, VkImageLayout layout)
+{
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = layout;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 1;
+    write.dstArrayElement = slot;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
     for (const auto& availableFormat : availableFormats) {
         if (availableFormat.format == VK_FORMAT_R8G8B8A8_SRGB) { // VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR
@@ -90,6 +173,7 @@ static std::vector<char> readFile(const std::string& filename)
 
     if (!file.is_open()) {
         spdlog::error("failed to open {}!", filename);
+        return {};
     }
 
     size_t fileSize = (size_t) file.tellg();
@@ -108,37 +192,422 @@ VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code
     createInfo.codeSize = code.size();
     createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    if (vkCreateShaderModule(device, &createInfo, vkAllocator(VK_OBJECT_TYPE_SHADER_MODULE), &shaderModule) != VK_SUCCESS) {
         spdlog::error("Failed to create shader module!");
     }
     return shaderModule;
 }
 
-void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, Window* window)
+// Falls back to the required flags when no memory type has the preferred ones
+VkMemoryPropertyFlags preferMemoryProperties(VkPhysicalDevice physical, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physical, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((memProperties.memoryTypes[i].propertyFlags & preferred) == preferred) {
+            return preferred;
+        }
+    }
+    return required;
+}
+
+uint32_t findMemoryType(VkPhysicalDevice physical, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physical, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    spdlog::error("Failed to find suitable memory type");
+    return 0;
+}
+
+// Buffers shared between queue families are created concurrent instead of transferring ownership
+void createBuffer(const RenderDevice* rd, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, GpuBuffer& buffer,
+    uint32_t familyCount = 0, const uint32_t* families = nullptr)
 {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = familyCount > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = familyCount > 1 ? familyCount : 0;
+    bufferInfo.pQueueFamilyIndices = familyCount > 1 ? families : nullptr;
+    if (vkCreateBuffer(rd->logical, &bufferInfo, vkAllocator(VK_OBJECT_TYPE_BUFFER), &buffer.buffer) != VK_SUCCESS) {
+        spdlog::error("Failed to create buffer");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(rd->logical, buffer.buffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(rd->physical, memRequirements.memoryTypeBits, properties);
+    if (vkAllocateMemory(rd->logical, &allocInfo, vkAllocator(VK_OBJECT_TYPE_DEVICE_MEMORY), &buffer.memory) != VK_SUCCESS) {
+        spdlog::error("Failed to allocate buffer memory");
+    }
+    vkBindBufferMemory(rd->logical, buffer.buffer, buffer.memory, 0);
+    buffer.size = size;
+}
+
+void destroyBuffer(const RenderDevice* rd, GpuBuffer& buffer)
+{
+    vkDestroyBuffer(rd->logical, buffer.buffer, vkAllocator(VK_OBJECT_TYPE_BUFFER));
+    vkFreeMemory(rd->logical, buffer.memory, vkAllocator(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    buffer = GpuBuffer{};
+}
+
+// Blocking upload through a staging buffer, meant for data that changes rarely
+void uploadBuffer(const RenderDevice* rd, VkCommandPool commandPool, const GpuBuffer& dst, const void* data, VkDeviceSize size)
+{
+    GpuBuffer staging;
+    createBuffer(rd, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging);
+    void* mapped;
+    vkMapMemory(rd->logical, staging.memory, 0, size, 0, &mapped);
+    memcpy(mapped, data, static_cast<size_t>(size));
+    vkUnmapMemory(rd->logical, staging.memory);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    vkAllocateCommandBuffers(rd->logical, &allocInfo, &commandBuffer);
+
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0; // Optional
-    beginInfo.pInheritanceInfo = nullptr; // Optional
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    VkBufferCopy copyRegion{};
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer, staging.buffer, dst.buffer, 1, &copyRegion);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    vkQueueSubmit(rd->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(rd->graphicsQueue);
+
+    vkFreeCommandBuffers(rd->logical, commandPool, 1, &commandBuffer);
+    destroyBuffer(rd, staging);
+}
+
+// Skia style 0xAARRGGBB to the R8G8B8A8 unorm layout of LineVertex::color
+uint32_t packLineColor(uint32_t argb)
+{
+    uint32_t a = (argb >> 24) & 0xFF;
+    uint32_t r = (argb >> 16) & 0xFF;
+    uint32_t g = (argb >> 8) & 0xFF;
+    uint32_t b = argb & 0xFF;
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+SkColorType skiaColorType(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_R8G8B8A8_UNORM: return kRGBA_8888_SkColorType;
+        case VK_FORMAT_R8G8B8A8_SRGB: return kSRGBA_8888_SkColorType;
+        case VK_FORMAT_B8G8R8A8_UNORM: return kBGRA_8888_SkColorType;
+        // Skia has no sRGB BGRA type, the SkColorSpace given with it does the encoding instead
+        case VK_FORMAT_B8G8R8A8_SRGB: return kBGRA_8888_SkColorType;
+        default:
+            spdlog::error("No Skia color type for swapchain format {}", format);
+            return kUnknown_SkColorType;
+    }
+}
+
+void beginSecondaryCommandBuffer(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkCommandBufferUsageFlags flags)
+{
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | flags;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
 
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-        spdlog::error("Failed to begin recording command buffer");
+        spdlog::error("Failed to begin recording secondary command buffer");
+    }
+}
+
+// Each instance is one segment: binding 1 reads the same buffer one vertex ahead of binding 0
+void drawLines(VkCommandBuffer commandBuffer, const GpuBuffer& vertices, uint32_t vertexCount)
+{
+    if (vertexCount < 2)
+    {
+        return;
+    }
+    VkBuffer buffers[] = {vertices.buffer, vertices.buffer};
+    VkDeviceSize offsets[] = {0, sizeof(LineVertex)};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+    vkCmdDraw(commandBuffer, 6, vertexCount - 1, 0, 0);
+}
+
+// One dispatch per curve, all writing disjoint ranges of the curve vertex buffer
+void recordCurveCommands(const CurveCompute& curves)
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(curves.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        spdlog::error("Failed to begin recording curve command buffer");
+    }
+    vkCmdBindPipeline(curves.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, curves.pipeline);
+    vkCmdBindDescriptorSets(curves.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, curves.pipelineLayout, 0, 1, &curves.set, 0, nullptr);
+    for (const auto& dispatch : curves.dispatches)
+    {
+        vkCmdPushConstants(curves.commandBuffer, curves.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CurvePushConstants), &dispatch);
+        vkCmdDispatch(curves.commandBuffer, (dispatch.count + CURVE_WORKGROUP_SIZE - 1) / CURVE_WORKGROUP_SIZE, 1, 1);
+    }
+    if (vkEndCommandBuffer(curves.commandBuffer) != VK_SUCCESS) {
+        spdlog::error("Failed to record curve command buffer");
+    }
+}
+
+void setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor{};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+// Scene draws live in a secondary command buffer so they can share a render pass with Skia's.
+// They go to the scaled scene target, or straight to the swapchain when the scene opts out of scaling.
+void recordSceneCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, Window* window, bool scaled)
+{
+    VkExtent2D renderExtent = scaled ? window->sceneTarget.renderExtent : window->swapChainExtent;
+    if (scaled)
+    {
+        beginSecondaryCommandBuffer(commandBuffer, window->sceneTarget.renderPass, window->sceneTarget.framebuffer, 0);
+    }
+    else
+    {
+        beginSecondaryCommandBuffer(commandBuffer, window->renderPass, window->swapChainFramebuffers[imageIndex], 0);
+    }
+    setViewport(commandBuffer, renderExtent);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, window->graphicsPipeline);
+    // One bind for the whole pass, draws select their texture through a push constant
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, window->pipelineLayout, 0, 1, &window->bindlessSet, 0, nullptr);
+    for (const auto& drawable : window->drawables)
+    {
+        DrawPushConstants draw{};
+        draw.textureIndex = drawable.textureIndex;
+        vkCmdPushConstants(commandBuffer, window->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawPushConstants), &draw);
+        vkCmdDraw(commandBuffer, drawable.vertexCount, 1, 0, 0);
+    }
+
+    if (window->linePipeline != VK_NULL_HANDLE)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, window->linePipeline);
+        LinePushConstants line{};
+        line.viewport = {window->swapChainExtent.width / window->contentScale, window->swapChainExtent.height / window->contentScale};
+        line.scale = window->contentScale * renderExtent.width / window->swapChainExtent.width;
+        vkCmdPushConstants(commandBuffer, window->linePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(LinePushConstants), &line);
+        drawLines(commandBuffer, window->lineVertices, window->lineVertexCount);
+        drawLines(commandBuffer, window->curves.vertices, window->curves.vertexCount);
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        spdlog::error("Failed to record scene command buffer");
+    }
+}
+
+// Samples the scene target over the whole swapchain image
+void recordUpscaleCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, Window* window, float sharpness)
+{
+    SceneTarget& target = window->sceneTarget;
+    beginSecondaryCommandBuffer(commandBuffer, window->renderPass, window->swapChainFramebuffers[imageIndex], 0);
+    if (target.upscalePipeline != VK_NULL_HANDLE)
+    {
+        setViewport(commandBuffer, window->swapChainExtent);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, target.upscalePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, target.upscalePipelineLayout, 0, 1, &window->bindlessSet, 0, nullptr);
+        UpscalePushConstants upscale{};
+        upscale.textureIndex = target.textureSlot;
+        upscale.sharpness = sharpness;
+        upscale.uvScale = {
+            static_cast<float>(target.renderExtent.width) / target.allocatedExtent.width,
+            static_cast<float>(target.renderExtent.height) / target.allocatedExtent.height
+        };
+        vkCmdPushConstants(commandBuffer, target.upscalePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscalePushConstants), &upscale);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        spdlog::error("Failed to record upscale command buffer");
+    }
+}
+
+// Single color attachment pass. The swapchain and scene target passes differ only in finalLayout, so
+// pipelines and secondaries built against one are compatible with the other; that requires identical
+// subpass dependencies, which therefore cover both uses:
+// - the previous frame's upscale must finish reading the scene target before it is overwritten
+// - the upscale and the capture copy wait for the writes and the final layout transition
+VkRenderPass createColorRenderPass(const RenderDevice* rd, VkFormat format, VkImageLayout finalLayout)
+{
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = format;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = finalLayout;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    if (vkCreateRenderPass(rd->logical, &renderPassInfo, vkAllocator(VK_OBJECT_TYPE_RENDER_PASS), &renderPass) != VK_SUCCESS)
+    {
+        return VK_NULL_HANDLE;
     }
+    return renderPass;
+}
 
+void beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent)
+{
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = window->renderPass;
-    renderPassInfo.framebuffer = window->swapChainFramebuffers[imageIndex];
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffer;
     renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = window->swapChainExtent;
+    renderPassInfo.renderArea.extent = extent;
     VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, window->graphicsPipeline);
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+}
+
+// Copies the presented image into a readback buffer after the frame's last render pass and makes
+// the copy visible to the host once the frame's fence signals
+void recordCaptureCopy(VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, VkBuffer buffer)
+{
+    VkImageMemoryBarrier toTransfer{};
+    toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = image;
+    toTransfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toTransfer.subresourceRange.levelCount = 1;
+    toTransfer.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+    VkImageMemoryBarrier toPresent = toTransfer;
+    toPresent.srcAccessMask = 0;
+    toPresent.dstAccessMask = 0;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkMemoryBarrier toHost{};
+    toHost.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 1, &toHost, 0, nullptr, 1, &toPresent);
+}
+
+// Scaled layers render into the scene target first, then the swapchain pass upscales it and
+// draws the native resolution layers on top. Timestamps bracket the render passes for the resolution
+// controller. The first is written at color attachment output, behind the submit's semaphore waits,
+// so time spent waiting for the swapchain image under FIFO doesn't count as render time.
+void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, Window* window,
+    uint32_t scaledCount, const VkCommandBuffer* scaled, uint32_t nativeCount, const VkCommandBuffer* native,
+    VkBuffer captureBuffer = VK_NULL_HANDLE)
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        spdlog::error("Failed to begin recording command buffer");
+    }
+    SceneTarget& target = window->sceneTarget;
+    bool timestamps = target.timestampPool != VK_NULL_HANDLE;
+    if (timestamps)
+    {
+        vkCmdResetQueryPool(commandBuffer, target.timestampPool, 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, target.timestampPool, 0);
+    }
+
+    if (scaledCount > 0)
+    {
+        beginRenderPass(commandBuffer, target.renderPass, target.framebuffer, target.renderExtent);
+        vkCmdExecuteCommands(commandBuffer, scaledCount, scaled);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    beginRenderPass(commandBuffer, window->renderPass, window->swapChainFramebuffers[imageIndex], window->swapChainExtent);
+    vkCmdExecuteCommands(commandBuffer, nativeCount, native);
     vkCmdEndRenderPass(commandBuffer);
+
+    // The readback isn't render work, it stays outside the bracket so capturing doesn't lower the resolution
+    if (timestamps)
+    {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, target.timestampPool, 1);
+        target.timestampsWritten = true;
+    }
+
+    if (captureBuffer != VK_NULL_HANDLE)
+    {
+        recordCaptureCopy(commandBuffer, window->swapChainImages[imageIndex], window->swapChainExtent, captureBuffer);
+    }
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         spdlog::error("Failed to record command buffer");
-    }   
-}
\ No newline at end of file
+    }
+}